@@ -0,0 +1,111 @@
+/*
+  A bounded multi-producer multi-consumer queue of jobs, each with a
+  weight (e.g., its number of bases). Jobs are moved in and out in
+  batches, so that the lock is taken once per batch rather than once per
+  job, and a producer is blocked while the queue holds its capacity, so
+  that the memory of the queued jobs is bounded by it instead of by the
+  whole input.
+
+  A consumer takes a share of what is queued: about 1/(2*consumers) of
+  the queued weight (at least one job), i.e., large batches while the
+  queue is full and single jobs when it is draining, so that the last
+  jobs are still spread over the consumers.
+
+  Last edited: 10/16/2026
+*/
+
+#ifndef _BOUNDEDQUEUE_H
+#define _BOUNDEDQUEUE_H 1
+
+#include <cstddef>
+#include <vector>
+#include <deque>
+#include <utility>
+#include <mutex>
+#include <condition_variable>
+
+template<class J>
+class BoundedQueue{
+public:
+    /*
+      Jobs collected by a producer (or taken by a consumer) with their
+      weights.
+    */
+    struct Batch{
+	std::vector<std::pair<J, size_t> > jobs;
+	size_t weight = 0;
+
+	void add(J&& job, const size_t w){
+	    jobs.emplace_back(std::move(job), w);
+	    weight += w;
+	}
+	bool empty() const { return jobs.empty(); };
+	void clear(){
+	    jobs.clear();
+	    weight = 0;
+	}
+    };
+
+private:
+    std::deque<std::pair<J, size_t> > jobs;
+    size_t weight; //total weight of the queued jobs
+    const size_t capacity;
+    const size_t consumers;
+    std::mutex door;
+    std::condition_variable whistle; //for the producers
+
+    //move the share of a consumer to b, the queue is locked and not empty
+    void takeShare(Batch& b){
+	size_t share = weight / (2*consumers);
+	do{
+	    b.jobs.push_back(std::move(jobs.front()));
+	    b.weight += b.jobs.back().second;
+	    jobs.pop_front();
+	}while(!jobs.empty() && b.weight + jobs.front().second <= share);
+	weight -= b.weight;
+    }
+
+public:
+    BoundedQueue(const size_t capacity, const size_t consumers):
+	weight(0), capacity(capacity),
+	consumers(consumers < 1 ? 1 : consumers) {};
+    BoundedQueue(const BoundedQueue&) = delete;
+    BoundedQueue& operator = (const BoundedQueue&) = delete;
+
+    /*
+      Move the jobs of b to the queue (b is cleared), wait until there is
+      room for them. A batch heavier than the capacity is let in when the
+      queue is empty.
+    */
+    void push(Batch& b){
+	if(b.empty()) return;
+	std::unique_lock<std::mutex> lock(door);
+	while(weight > 0 && weight + b.weight > capacity){
+	    whistle.wait(lock);
+	}
+	for(auto& x : b.jobs){
+	    jobs.push_back(std::move(x));
+	}
+	weight += b.weight;
+	lock.unlock();
+	b.clear();
+    }
+
+    /*
+      Take the next jobs into b (cleared first), return false right away
+      if the queue is empty (the consumers wait on their own, see
+      ThreadPool).
+    */
+    bool tryPop(Batch& b){
+	b.clear();
+	std::unique_lock<std::mutex> lock(door);
+	if(jobs.empty()) return false;
+
+	takeShare(b);
+	lock.unlock();
+	whistle.notify_all();
+	return true;
+    }
+};
+
+#endif // BoundedQueue.hpp
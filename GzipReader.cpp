@@ -0,0 +1,266 @@
+#include "GzipReader.h"
+#include <cstring>
+#include <zlib.h>
+
+bool isGzipFile(const char* filename){
+    FILE* fin = fopen(filename, "rb");
+    if(fin == NULL) return false;
+    unsigned char magic[2];
+    bool ret = fread(magic, 1, 2, fin) == 2
+	&& magic[0] == 0x1f && magic[1] == 0x8b;
+    fclose(fin);
+    return ret;
+}
+
+/*
+  BSIZE of a BGZF block (total size minus 1) from its extra field, -1 if
+  there is no BC subfield.
+*/
+static int getBgzfBlockSize(const unsigned char* extra, const int xlen){
+    int i, slen;
+    for(i=0; i+4<=xlen; i+=4+slen){
+	slen = extra[i+2] | (extra[i+3]<<8);
+	if(extra[i] == 'B' && extra[i+1] == 'C' && slen == 2 && i+6 <= xlen){
+	    return extra[i+4] | (extra[i+5]<<8);
+	}
+    }
+    return -1;
+}
+
+GzipReader::GzipReader(const char* filename, const int threads):
+    fin(NULL), bgzf(false), failed(false), done(false),
+    num_batches(0), next_batch(0){
+    fin = fopen(filename, "rb");
+    if(fin == NULL){
+	fprintf(stderr, "Cannot open %s\n", filename);
+	failed = done = true;
+	return;
+    }
+
+    //FEXTRA with a BC subfield
+    unsigned char h[12], extra[1<<16];
+    int xlen;
+    if(fread(h, 1, 12, fin) == 12 && h[0] == 0x1f && h[1] == 0x8b
+       && h[2] == 8 && (h[3] & 4)){
+	xlen = h[10] | (h[11]<<8);
+	bgzf = fread(extra, 1, xlen, fin) == (size_t)xlen
+	    && getBgzfBlockSize(extra, xlen) >= 0;
+    }
+
+    if(bgzf){
+	rewind(fin);
+	minions.emplace_back(&GzipReader::readBlocks, this);
+	for(int i=0; i<threads || i<1; ++i){
+	    minions.emplace_back(&GzipReader::inflateBlocks, this);
+	}
+    }else{
+	fclose(fin);
+	fin = NULL;
+	minions.emplace_back(&GzipReader::inflatePlain, this,
+			     std::string(filename));
+    }
+}
+
+GzipReader::~GzipReader(){
+    {//stop the threads if the file is not read to the end
+	std::lock_guard<std::mutex> lock(door);
+	failed = true;
+    }
+    trumpet.notify_all();
+    for(auto& x : minions){
+	x.join();
+    }
+    if(fin) fclose(fin);
+}
+
+bool GzipReader::good(){
+    std::lock_guard<std::mutex> lock(door);
+    return !failed;
+}
+
+void GzipReader::fail(const char* msg){
+    {
+	std::lock_guard<std::mutex> lock(door);
+	if(!failed) fprintf(stderr, "%s\n", msg);
+	failed = true;
+    }
+    trumpet.notify_all();
+}
+
+void GzipReader::inflatePlain(const std::string filename){
+    gzFile gz = gzopen(filename.c_str(), "rb");
+    if(gz == NULL){
+	fail("Cannot open the gzip file");
+	return;
+    }
+    gzbuffer(gz, 1<<17);
+
+    std::string block;
+    int len, err;
+    std::unique_lock<std::mutex> lock(door, std::defer_lock);
+    while(true){
+	block.resize(GZIPBLOCKSIZE);
+	len = gzread(gz, &block[0], GZIPBLOCKSIZE);
+	if(len <= 0) break;
+	block.resize(len);
+
+	lock.lock();
+	while(!failed && num_batches - next_batch >= GZIPMAXBATCHES){
+	    trumpet.wait(lock);
+	}
+	if(failed){
+	    gzclose(gz);
+	    return;
+	}
+	results.emplace(num_batches++, std::move(block));
+	lock.unlock();
+	trumpet.notify_all();
+    }
+
+    //a truncated file gives Z_BUF_ERROR
+    gzerror(gz, &err);
+    gzclose(gz);
+    if(len < 0 || (err != Z_OK && err != Z_STREAM_END)){
+	fail("The gzip file is corrupted or truncated");
+	return;
+    }
+    lock.lock();
+    done = true;
+    lock.unlock();
+    trumpet.notify_all();
+}
+
+void GzipReader::readBlocks(){
+    unsigned char h[12];
+    int xlen, bsize;
+    size_t st, got;
+    std::unique_lock<std::mutex> lock(door, std::defer_lock);
+
+    while(true){
+	Batch b;
+	for(got=1; b.ends.size()<BGZFBATCHBLOCKS; ){
+	    got = fread(h, 1, 12, fin);
+	    if(got == 0) break; //end of file
+	    if(got != 12 || h[0] != 0x1f || h[1] != 0x8b || h[2] != 8
+	       || !(h[3] & 4)){
+		fail("The BGZF file is corrupted or truncated");
+		return;
+	    }
+	    //the block is header, extra field, data, crc32 and isize
+	    xlen = h[10] | (h[11]<<8);
+	    st = b.data.size();
+	    b.data.append((const char*)h, 12);
+	    b.data.resize(st+12+xlen);
+	    if(fread(&b.data[st+12], 1, xlen, fin) != (size_t)xlen
+	       || (bsize = getBgzfBlockSize((const unsigned char*)&b.data[st+12],
+					   xlen)) < 12+xlen+8){
+		fail("The BGZF file is corrupted or truncated");
+		return;
+	    }
+	    b.data.resize(st+bsize+1);
+	    if(fread(&b.data[st+12+xlen], 1, bsize+1-12-xlen, fin)
+	       != (size_t)(bsize+1-12-xlen)){
+		fail("The BGZF file is corrupted or truncated");
+		return;
+	    }
+	    b.ends.push_back(b.data.size());
+	}
+	if(b.ends.empty()) break;
+
+	lock.lock();
+	while(!failed && num_batches - next_batch >= GZIPMAXBATCHES){
+	    trumpet.wait(lock);
+	}
+	if(failed) return;
+	b.id = num_batches++;
+	jobs.push(std::move(b));
+	lock.unlock();
+	trumpet.notify_all();
+	if(got == 0) break;
+    }
+
+    lock.lock();
+    done = true;
+    lock.unlock();
+    trumpet.notify_all();
+}
+
+bool GzipReader::inflateBatch(const Batch& b, std::string& out) const{
+    z_stream zs;
+    memset(&zs, 0, sizeof zs);
+    if(inflateInit2(&zs, -15) != Z_OK) return false; //raw deflate
+
+    const unsigned char* block;
+    size_t st = 0, len, out_st;
+    uint32_t crc, isize;
+    int xlen, ret;
+    bool ok = true;
+
+    for(size_t ed : b.ends){
+	block = (const unsigned char*)b.data.data() + st;
+	len = ed - st;
+	xlen = block[10] | (block[11]<<8);
+	memcpy(&crc, block+len-8, 4); //little-endian
+	memcpy(&isize, block+len-4, 4);
+	if(isize > BGZFMAXISIZE){//not allocated for a bad block
+	    ok = false;
+	    break;
+	}
+
+	out_st = out.size();
+	out.resize(out_st + isize);
+	inflateReset(&zs);
+	zs.next_in = (unsigned char*)block + 12 + xlen;
+	zs.avail_in = len - 12 - xlen - 8;
+	zs.next_out = (unsigned char*)&out[out_st];
+	zs.avail_out = isize;
+	ret = inflate(&zs, Z_FINISH);
+	if(ret != Z_STREAM_END || zs.total_out != isize
+	   || crc32(0, (const unsigned char*)out.data()+out_st, isize) != crc){
+	    ok = false;
+	    break;
+	}
+	st = ed;
+    }
+    inflateEnd(&zs);
+    return ok;
+}
+
+void GzipReader::inflateBlocks(){
+    std::unique_lock<std::mutex> lock(door);
+    while(true){
+	while(!failed && !done && jobs.empty()){
+	    trumpet.wait(lock);
+	}
+	if(failed || jobs.empty()) return;
+
+	Batch b = std::move(jobs.front());
+	jobs.pop();
+	lock.unlock();
+	std::string out;
+	if(!inflateBatch(b, out)){
+	    fail("The BGZF file is corrupted");
+	    return;
+	}
+	lock.lock();
+	results.emplace(b.id, std::move(out));
+	trumpet.notify_all();
+    }
+}
+
+bool GzipReader::read(std::string& out){
+    std::unique_lock<std::mutex> lock(door);
+    while(!failed && results.count(next_batch) == 0
+	  && !(done && next_batch == num_batches)){
+	trumpet.wait(lock);
+    }
+    auto it = results.find(next_batch);
+    if(failed || it == results.end()) return false;
+
+    out.append(it->second);
+    results.erase(it);
+    ++next_batch;
+    lock.unlock();
+    trumpet.notify_all();
+    return true;
+}
@@ -0,0 +1,88 @@
+/*
+  Streaming decompression of a gzip file on threads of its own, so that
+  a compressed read file is neither decompressed to disk nor held in
+  memory as a whole. The decompressed data are handed out in blocks, in
+  the order of the file.
+
+  A BGZF file (e.g., from bgzip) is a series of independent gzip blocks
+  of at most 64KB each, they are read by one thread and inflated in
+  batches by the others in parallel. Any other gzip file (including
+  concatenated members) is inflated by a single thread. At most
+  GZIPMAXBATCHES decompressed batches are kept ahead of the consumer.
+
+  Last edited: 10/16/2026
+*/
+
+#ifndef _GZIPREADER_H
+#define _GZIPREADER_H 1
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <map>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#define GZIPMAXBATCHES 16
+#define GZIPBLOCKSIZE (1<<22) //decompressed size of a batch of plain gzip
+#define BGZFBATCHBLOCKS 64 //number of BGZF blocks in a batch
+#define BGZFMAXISIZE 65536 //largest decompressed size of a BGZF block
+
+/*
+  Whether the file starts with the gzip magic bytes.
+*/
+bool isGzipFile(const char* filename);
+
+class GzipReader{
+    //a batch of compressed BGZF blocks
+    struct Batch{
+	size_t id;
+	std::string data;
+	std::vector<size_t> ends; //end of each block in data
+    };
+
+    FILE* fin;
+    bool bgzf;
+    bool failed;
+    bool done; //no more batch will be produced
+    size_t num_batches; //batches produced (or being inflated) so far
+    size_t next_batch; //the next one to be handed out
+    std::queue<Batch> jobs;
+    std::map<size_t, std::string> results;
+    std::vector<std::thread> minions;
+    std::mutex door;
+    std::condition_variable trumpet;
+
+    void fail(const char* msg);
+    //the single thread of plain gzip
+    void inflatePlain(const std::string filename);
+    //the reader thread of BGZF
+    void readBlocks();
+    //the worker threads of BGZF
+    void inflateBlocks();
+    bool inflateBatch(const Batch& b, std::string& out) const;
+
+public:
+    /*
+      Start decompressing the file, with threads workers for BGZF.
+      good() is false (with a message on stderr) if the file cannot be
+      opened or becomes false if it is corrupted.
+    */
+    GzipReader(const char* filename, const int threads);
+    ~GzipReader();
+    GzipReader(const GzipReader&) = delete;
+    GzipReader& operator = (const GzipReader&) = delete;
+
+    bool good();
+    bool isBgzf() const { return bgzf; };
+
+    /*
+      Append the next decompressed batch to out, return false (without
+      changing out) at the end of the file or after an error.
+    */
+    bool read(std::string& out);
+};
+
+#endif // GzipReader.h
@@ -0,0 +1,81 @@
+/*
+  Fixed-width k-mers of W 64-bit words, used in place of kmer (see util.h)
+  for k > 64. The encoding is that of kmer: the last char of a k-mer is at
+  the two least significant bits, w[0] holds the 32 last chars. The order
+  is the numeric order of the 64W-bit numbers, i.e., seeds sort the same
+  as with kmer.
+
+  The chars are accessed by setKmerBase/getKmerBase, which are overloaded
+  for kmer with the usual shifts so that k <= 64 is not slowed down.
+
+  Last edited: 10/16/2026
+*/
+
+#ifndef _LONGKMER_H
+#define _LONGKMER_H 1
+
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+
+template<int W>
+struct LongKmer{
+    uint64_t w[W];
+
+    LongKmer(const uint64_t x=0){
+	w[0] = x;
+	for(int i=1; i<W; ++i) w[i] = 0;
+    };
+
+    bool operator == (const LongKmer& o) const{
+	for(int i=0; i<W; ++i){
+	    if(w[i] != o.w[i]) return false;
+	}
+	return true;
+    }
+    bool operator != (const LongKmer& o) const{
+	return !(*this == o);
+    }
+    bool operator < (const LongKmer& o) const{
+	for(int i=W-1; i>=0; --i){
+	    if(w[i] != o.w[i]) return w[i] < o.w[i];
+	}
+	return false;
+    }
+};
+
+/*
+  k-mers with k up to 128.
+*/
+#define LONGKMERMAXK 128
+typedef LongKmer<(LONGKMERMAXK+31)/32> longkmer;
+
+/*
+  Set (resp. get) the char at bits b and b+1, b is even and x is assumed
+  to have zeros there before setKmerBase.
+*/
+template<int W>
+static inline void setKmerBase(LongKmer<W>& x, const int b, const int c){
+    x.w[b>>6] |= (uint64_t)c << (b&63);
+}
+
+template<int W>
+static inline int getKmerBase(const LongKmer<W>& x, const int b){
+    return (x.w[b>>6] >> (b&63)) & 3;
+}
+
+namespace std{
+template<int W>
+struct hash<LongKmer<W> >{
+    size_t operator()(const LongKmer<W>& x) const{
+	uint64_t h = 0;
+	for(int i=0; i<W; ++i){
+	    h = (h ^ x.w[i]) * 0x9e3779b97f4a7c15ull;
+	    h ^= h >> 32;
+	}
+	return h;
+    }
+};
+}
+
+#endif // LongKmer.hpp
@@ -0,0 +1,141 @@
+#include "PairCounter.h"
+#include <cstdio>
+
+PairCounter::PairCounter(const size_t n): id_bits(1){
+    while(id_bits < 32 && (n >> id_bits) > 0) ++id_bits;
+}
+
+/*
+  Sort the keys of the given number of bits by an LSD radix sort with
+  digits of up to PAIRCOUNTERRADIXBITS bits, tmp is used as the buffer
+  of the passes. The counts of all the digits are taken in a single
+  read of the keys.
+*/
+static void radixSort(std::vector<uint64_t>& keys, std::vector<uint64_t>& tmp,
+		      const int bits){
+    int num_passes = (bits + PAIRCOUNTERRADIXBITS - 1) / PAIRCOUNTERRADIXBITS;
+    int width = (bits + num_passes - 1) / num_passes, p;
+    size_t num = keys.size(), buckets = (size_t)1 << width, total, x, i, c;
+    uint64_t mask = buckets - 1;
+    std::vector<size_t> counts(num_passes * buckets, 0);
+
+    for(i=0; i<num; ++i){
+	for(p=0; p<num_passes; ++p){
+	    ++counts[p*buckets + ((keys[i] >> (p*width)) & mask)];
+	}
+    }
+
+    tmp.resize(num);
+    for(p=0; p<num_passes; ++p){
+	size_t* ct = counts.data() + p*buckets;
+	int shift = p*width;
+	if(ct[(keys[0] >> shift) & mask] == num) continue;
+	for(total=0, c=0; c<buckets; ++c){
+	    x = ct[c];
+	    ct[c] = total;
+	    total += x;
+	}
+	for(i=0; i<num; ++i){
+	    tmp[ct[(keys[i] >> shift) & mask]++] = keys[i];
+	}
+	keys.swap(tmp);
+    }
+}
+
+void PairCounter::flush(){
+    if(buf.empty()) return;
+
+    radixSort(buf, tmp, id_bits << 1);
+
+    Run r;
+    size_t num = buf.size(), i;
+    for(i=0; i<num; ++i){
+	if(i == 0 || buf[i] != buf[i-1]){
+	    r.keys.push_back(buf[i]);
+	    r.counts.push_back(1);
+	}else{
+	    ++r.counts.back();
+	}
+    }
+    buf.clear();
+    runs.push_back(std::move(r));
+    mergeRuns(false);
+}
+
+/*
+  Merge the last two runs while the last one is at least half as large
+  as the one before it (or until there is one run if all).
+*/
+void PairCounter::mergeRuns(const bool all){
+    size_t s;
+    while((s = runs.size()) > 1){
+	if(!all && (runs[s-1].keys.size() << 1) < runs[s-2].keys.size()){
+	    break;
+	}
+	Run& a = runs[s-2];
+	Run& b = runs[s-1];
+	Run r;
+	r.keys.reserve(a.keys.size() + b.keys.size());
+	r.counts.reserve(a.keys.size() + b.keys.size());
+	size_t i = 0, j = 0;
+	while(i < a.keys.size() || j < b.keys.size()){
+	    if(j == b.keys.size()
+	       || (i < a.keys.size() && a.keys[i] < b.keys[j])){
+		r.keys.push_back(a.keys[i]);
+		r.counts.push_back(a.counts[i++]);
+	    }else if(i == a.keys.size() || b.keys[j] < a.keys[i]){
+		r.keys.push_back(b.keys[j]);
+		r.counts.push_back(b.counts[j++]);
+	    }else{
+		r.keys.push_back(a.keys[i]);
+		r.counts.push_back(a.counts[i++] + b.counts[j++]);
+	    }
+	}
+	runs.pop_back();
+	runs.back() = std::move(r);
+    }
+}
+
+void PairCounter::merge(PairCounter& o){
+    o.flush();
+    flush();
+    for(Run& r : o.runs){
+	runs.push_back(std::move(r));
+    }
+    o.runs.clear();
+    mergeRuns(true);
+}
+
+size_t PairCounter::size(){
+    flush();
+    mergeRuns(true);
+    return runs.empty() ? 0 : runs[0].keys.size();
+}
+
+void PairCounter::saveNoneZeroEntries(const char* filename,
+				      const char* mode/*="w"*/,
+				      const bool rev/*=false*/){
+    flush();
+    mergeRuns(true);
+    FILE* fout = fopen(filename, mode);
+    if(fout == NULL){
+	fprintf(stderr, "Cannot open %s\n", filename);
+	return;
+    }
+
+    if(!runs.empty()){
+	const Run& r = runs[0];
+	size_t i, a, b;
+	for(i=0; i<r.keys.size(); ++i){
+	    a = r.keys[i] >> id_bits;
+	    b = r.keys[i] & (((uint64_t)1 << id_bits) - 1);
+	    if(rev){
+		fprintf(fout, "%zu %zu %u\n", b, a, r.counts[i]);
+	    }else{
+		fprintf(fout, "%zu %zu %u\n", a, b, r.counts[i]);
+	    }
+	}
+    }
+
+    fclose(fout);
+}
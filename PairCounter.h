@@ -0,0 +1,71 @@
+/*
+  Counts of pairs of reads (e.g., of the seeds they share), in place of
+  an upper triangular matrix of all the n(n-1)/2 pairs: the memory is
+  proportional to the pairs counted instead of to n^2.
+
+  A pair (i, j) is a key i<<b | j, where b is the number of bits of n.
+  The keys are appended to a buffer, a full buffer is sorted by an LSD
+  radix sort (on the 2b bits of the keys only) and collapsed into a run
+  of distinct keys with their counts. The runs are merged as they come,
+  whenever the last run is at least half as large as the one before it,
+  so that each key is merged O(log) times and the runs stay sorted.
+
+  The pairs of several threads are counted by a counter per thread,
+  merged into one at the end (see merge).
+
+  Last edited: 10/16/2026
+*/
+
+#ifndef _PAIRCOUNTER_H
+#define _PAIRCOUNTER_H 1
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+#define PAIRCOUNTERBUFFER (1lu<<20) //keys buffered before a run is made
+#define PAIRCOUNTERRADIXBITS 12 //largest digit of the radix sort
+
+class PairCounter{
+    struct Run{
+	std::vector<uint64_t> keys; //ascending
+	std::vector<unsigned int> counts;
+    };
+
+    int id_bits; //of the ids up to n
+    std::vector<uint64_t> buf;
+    std::vector<uint64_t> tmp; //of the sort of buf
+    std::vector<Run> runs;
+
+    void flush();
+    void mergeRuns(const bool all);
+
+public:
+    /*
+      Counts of the pairs (i, j) with 1<=i<j<=n, n < 2^32.
+    */
+    explicit PairCounter(const size_t n);
+
+    //count the pair (i, j) once more, 1<=i<j<=n
+    void add(const size_t i, const size_t j){
+	buf.push_back((uint64_t)i << id_bits | j);
+	if(buf.size() >= PAIRCOUNTERBUFFER) flush();
+    };
+
+    /*
+      Add the counts of o (of the same n) to this counter, o is emptied.
+    */
+    void merge(PairCounter& o);
+
+    //number of the pairs counted at least once
+    size_t size();
+
+    /*
+      For each pair (i, j) counted c times, output "i j c" (in ascending
+      order of i then j); if rev, output "j i c".
+    */
+    void saveNoneZeroEntries(const char* filename, const char* mode="w",
+			     const bool rev=false);
+};
+
+#endif // PairCounter.h
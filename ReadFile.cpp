@@ -0,0 +1,306 @@
+#include "ReadFile.h"
+#include <cstdio>
+#include <cstring>
+#include <cctype>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+size_t readFileStemLength(const char* filename){
+    const char* base = strrchr(filename, '/');
+    const char* ext;
+    size_t len = strlen(filename);
+
+    base = base ? base+1 : filename;
+    if(len-(base-filename) > 3 && strcmp(filename+len-3, ".gz") == 0){
+	len -= 3;
+    }
+    ext = (const char*)memrchr(base, '.', len-(base-filename));
+    if(ext != NULL && ext != base) len = ext - filename;
+    return len;
+}
+
+/*
+  Whether the line at pos of a FASTQ buffer is a header: a quality line
+  may also start with '@', a header is two lines before a '+' line.
+*/
+static bool isFastqHeader(const char* data, const size_t size, size_t pos){
+    const char* p;
+    for(int l=0; l<2 && pos<size; ++l){
+	p = (const char*)memchr(data+pos, '\n', size-pos);
+	pos = p ? p - data + 1 : size;
+    }
+    return pos < size && data[pos] == '+';
+}
+
+/*
+  The start of the first record at or after pos in a buffer (size if
+  none).
+*/
+static size_t recordStart(const char* data, const size_t size, size_t pos,
+			  const bool fastq){
+    const char marker = fastq ? '@' : '>';
+    const char* p;
+
+    if(pos == 0) return 0;
+    while(pos < size){
+	if(data[pos-1] != '\n'){//go to the start of the next line
+	    p = (const char*)memchr(data+pos, '\n', size-pos);
+	    if(p == NULL) return size;
+	    pos = p - data + 1;
+	    if(pos >= size) return size;
+	}
+	if(data[pos] == marker && (!fastq || isFastqHeader(data, size, pos))){
+	    return pos;
+	}
+	++pos;
+    }
+    return size;
+}
+
+size_t ReadRecord::headerNumber() const{
+    size_t i = 0, x = 0;
+    while(i < header_len && (header[i] == ' ' || header[i] == '\t')) ++i;
+    for(; i < header_len && isdigit((unsigned char)header[i]); ++i){
+	x = x*10 + (header[i] - '0');
+    }
+    return x;
+}
+
+ReadFile::ReadFile(const char* filename):
+    data(NULL), size(0), fastq(false), ok(false){
+    int fd = open(filename, O_RDONLY);
+    if(fd < 0){
+	fprintf(stderr, "Cannot open %s\n", filename);
+	return;
+    }
+
+    struct stat st;
+    if(fstat(fd, &st) != 0){
+	fprintf(stderr, "Cannot stat %s\n", filename);
+	close(fd);
+	return;
+    }
+    if(st.st_size > 0){
+	void* p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if(p == MAP_FAILED){
+	    fprintf(stderr, "Cannot map %s\n", filename);
+	    close(fd);
+	    return;
+	}
+	madvise(p, st.st_size, MADV_SEQUENTIAL);
+	data = (const char*)p;
+	size = st.st_size;
+    }
+    close(fd); //the mapping stays valid
+
+    size_t i;
+    for(i=0; i<size && isspace((unsigned char)data[i]); ++i);
+    if(i < size && data[i] != '>' && data[i] != '@'){
+	fprintf(stderr, "%s is not a FASTA or FASTQ file\n", filename);
+	return;
+    }
+    fastq = (i < size && data[i] == '@');
+    ok = true;
+}
+
+ReadFile::~ReadFile(){
+    if(data) munmap((void*)data, size);
+}
+
+std::vector<std::pair<size_t, size_t> > ReadFile::split(
+    const int parts, const size_t from/*=0*/) const{
+    std::vector<std::pair<size_t, size_t> > ranges;
+    size_t st = from, ed;
+    for(int i=1; i<=parts && st<size; ++i){
+	ed = i == parts ? size
+	    : recordStart(data, size,
+			  std::max(st, from + (size-from) / parts * i), fastq);
+	if(ed > st){
+	    ranges.emplace_back(st, ed);
+	    st = ed;
+	}
+    }
+    return ranges;
+}
+
+size_t ReadFile::countRecords(const size_t st, const size_t ed) const{
+    size_t count = 0;
+    if(fastq){
+	ReadParser parser(*this, st, ed);
+	ReadRecord r;
+	while(parser.next(r)) ++count;
+	return count;
+    }
+
+    //a header is a '>' at the start of a line
+    const char* p = data + st;
+    const char* e = data + ed;
+    while(p < e && (p = (const char*)memchr(p, '>', e-p)) != NULL){
+	if(p == data || p[-1] == '\n') ++count;
+	++p;
+    }
+    return count;
+}
+
+bool ReadFile::isRecordStart(const size_t pos) const{
+    return pos <= size && recordStart(data, size, pos, fastq) == pos;
+}
+
+ReadParser::ReadParser(const char* data, const size_t st, const size_t ed,
+		       const bool fastq, const size_t first_id):
+    data(data), cur(st), ed(ed), fastq(fastq), ok(true),
+    next_id(first_id) {}
+
+ReadParser::ReadParser(const ReadFile& file, const size_t st,
+		       const size_t ed, const size_t first_id/*=1*/):
+    ReadParser(file.data, st, ed, file.fastq, first_id) {}
+
+ReadParser::ReadParser(const ReadFile& file):
+    ReadParser(file, 0, file.size) {}
+
+size_t ReadParser::nextLine(size_t& pos, const char** line) const{
+    const char* s = data + pos;
+    const char* e = (const char*)memchr(s, '\n', ed-pos);
+    size_t len = e ? e - s : ed - pos;
+
+    pos += e ? len+1 : len;
+    if(len > 0 && s[len-1] == '\r') --len;
+    *line = s;
+    return len;
+}
+
+bool ReadParser::next(ReadRecord& r){
+    const char marker = fastq ? '@' : '>';
+    const char* line;
+    size_t len, lines;
+
+    while(cur < ed && isspace((unsigned char)data[cur])) ++cur;
+    if(cur >= ed) return false;
+    if(data[cur] != marker){
+	fprintf(stderr, "Malformed record at byte %zu\n", cur);
+	cur = ed;
+	ok = false;
+	return false;
+    }
+
+    ++cur;
+    r.header_len = nextLine(cur, &r.header);
+    r.id = next_id++;
+
+    if(fastq){
+	r.seq_len = nextLine(cur, &r.seq);
+	len = nextLine(cur, &line);
+	if(len == 0 || line[0] != '+'){
+	    fprintf(stderr, "Malformed FASTQ record %zu\n", r.id);
+	    cur = ed;
+	    ok = false;
+	    return false;
+	}
+	nextLine(cur, &line); //quality
+	r.end = cur;
+	return true;
+    }
+
+    //sequence lines up to the next header, only a multi-line sequence
+    //is copied
+    r.seq = data + cur;
+    r.seq_len = 0;
+    lines = 0;
+    while(cur < ed && data[cur] != '>'){
+	len = nextLine(cur, &line);
+	if(len == 0) continue;
+	if(lines == 0){
+	    r.seq = line;
+	    r.seq_len = len;
+	}else{
+	    if(lines == 1) joined.assign(r.seq, r.seq_len);
+	    joined.append(line, len);
+	}
+	++lines;
+    }
+    if(lines > 1){
+	r.seq = joined.data();
+	r.seq_len = joined.length();
+    }
+    r.end = cur;
+    return true;
+}
+
+ReadStream::ReadStream(const char* filename, const int threads):
+    reader(filename, threads), boundary(0), scanned(0), fastq(false),
+    ok(true), eof(false) {
+    lines[0] = lines[1] = 0;
+}
+
+bool ReadStream::good(){
+    return ok && parser.good() && reader.good();
+}
+
+void ReadStream::findRecordStarts(){
+    const char marker = fastq ? '@' : '>';
+    const char* data = buf.data();
+    const char* p;
+    size_t size = buf.size(), pos = scanned > 0 ? scanned-1 : 0;
+
+    //the lines starting in [scanned, size), the newline before the
+    //first one may be the last char searched before
+    while(pos+1 < size
+	  && (p = (const char*)memchr(data+pos, '\n', size-1-pos)) != NULL){
+	pos = p - data + 1;
+	if(fastq){//a quality line may also start with '@', a header is
+		  //two lines before a '+' line
+	    if(data[pos] == '+' && lines[0] > 0 && data[lines[0]] == marker){
+		boundary = lines[0];
+	    }
+	    lines[0] = lines[1];
+	    lines[1] = pos;
+	}else if(data[pos] == marker){
+	    boundary = pos;
+	}
+    }
+    scanned = size;
+}
+
+bool ReadStream::refill(){
+    if(eof || !ok) return false;
+    buf.erase(0, boundary);
+    boundary = scanned = 0;
+    lines[0] = lines[1] = 0;
+
+    size_t i;
+    while(boundary == 0){
+	if(!reader.read(buf)){
+	    if(!reader.good()){//do not parse a truncated record
+		ok = false;
+		return false;
+	    }
+	    eof = true;
+	    boundary = buf.size();
+	    break;
+	}
+	if(scanned == 0){//the format is known from the first char
+	    for(i=0; i<buf.size() && isspace((unsigned char)buf[i]); ++i);
+	    if(i == buf.size()) continue;
+	    if(buf[i] != '>' && buf[i] != '@'){
+		fprintf(stderr, "Not a FASTA or FASTQ file\n");
+		ok = false;
+		return false;
+	    }
+	    fastq = (buf[i] == '@');
+	}
+	findRecordStarts();
+    }
+
+    parser = ReadParser(buf.data(), 0, boundary, fastq, parser.nextId());
+    return boundary > 0;
+}
+
+bool ReadStream::next(ReadRecord& r){
+    while(!parser.next(r)){
+	if(!parser.good() || !refill()) return false;
+    }
+    return true;
+}
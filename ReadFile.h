@@ -0,0 +1,180 @@
+/*
+  Reads of an efa/FASTA or FASTQ file mapped in memory. The records are
+  given as views into the mapping (no copy, no std::string per read),
+  and the file can be split into byte ranges at record boundaries so
+  that several threads parse it in parallel.
+
+  FASTA records may span several lines: a single-line sequence (e.g.,
+  efa) is a view into the file, the lines of a multi-line sequence are
+  joined in a buffer of the parser, valid until its next record. FASTQ
+  records are expected to have 4 lines (the sequence on one line).
+  Line ends may be \n or \r\n.
+
+  A gzip-compressed file (see isGzipFile) cannot be mapped, it is read
+  by a ReadStream instead while a GzipReader decompresses it.
+
+  Last edited: 10/16/2026
+*/
+
+#ifndef _READFILE_H
+#define _READFILE_H 1
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <utility>
+#include "GzipReader.h"
+
+/*
+  Length of the name of a read file without its extension, the .gz
+  included, e.g., that of "dir/reads" for "dir/reads.fq.gz".
+*/
+size_t readFileStemLength(const char* filename);
+
+/*
+  A record of a read file, the views are not null-terminated.
+  --id is the 1-based index of the record in the file (see ReadParser);
+  --header excludes the leading '>' or '@';
+  --end is the offset right after the record in the data parsed (i.e.,
+    in the file for a ReadFile), the next record starts there.
+*/
+struct ReadRecord{
+    size_t id;
+    const char* header;
+    size_t header_len;
+    const char* seq;
+    size_t seq_len;
+    size_t end;
+
+    /*
+      The number at the start of the header (after spaces), 0 if none,
+      as read by "fin >> read_idx" after the '>'.
+    */
+    size_t headerNumber() const;
+};
+
+class ReadFile{
+    const char* data;
+    size_t size;
+    bool fastq;
+    bool ok;
+
+    friend class ReadParser;
+
+public:
+    /*
+      Map the file, good() is false (with a message on stderr) if it
+      cannot be opened or does not start with '>' or '@'.
+    */
+    explicit ReadFile(const char* filename);
+    ~ReadFile();
+    ReadFile(const ReadFile&) = delete;
+    ReadFile& operator = (const ReadFile&) = delete;
+
+    bool good() const { return ok; };
+    bool isFastq() const { return fastq; };
+    size_t length() const { return size; };
+
+    /*
+      Split the file from a record start (e.g., the end of a record)
+      into at most parts consecutive byte ranges [st, ed) of about the
+      same size, each starting at a record (empty ranges are dropped).
+    */
+    std::vector<std::pair<size_t, size_t> > split(const int parts,
+						  const size_t from=0) const;
+
+    /*
+      Number of records starting in [st, ed), e.g., to number the
+      records of the ranges of split before they are parsed.
+    */
+    size_t countRecords(const size_t st, const size_t ed) const;
+
+    /*
+      Whether a record starts at pos (or pos is the end of the file),
+      without parsing the records before it.
+    */
+    bool isRecordStart(const size_t pos) const;
+};
+
+/*
+  Sequential parser of the records in a byte range of a ReadFile (or of
+  a buffer holding whole records).
+  The records get consecutive ids from first_id, which is the id of the
+  first record of the range in the whole file if the ranges before it
+  have been counted by countRecords.
+*/
+class ReadParser{
+    const char* data;
+    size_t cur, ed;
+    bool fastq;
+    bool ok;
+    size_t next_id;
+    std::string joined;
+
+    /*
+      The line at pos (excluding its \r\n), pos is moved to the next one.
+    */
+    size_t nextLine(size_t& pos, const char** line) const;
+
+public:
+    ReadParser(const ReadFile& file, const size_t st, const size_t ed,
+	       const size_t first_id=1);
+    explicit ReadParser(const ReadFile& file);
+    ReadParser(const char* data, const size_t st, const size_t ed,
+	       const bool fastq, const size_t first_id);
+    ReadParser(): ReadParser(NULL, 0, 0, false, 1) {};
+
+    /*
+      Parse the next record into r, return false at the end of the range
+      (or at a malformed record, with a message on stderr).
+    */
+    bool next(ReadRecord& r);
+
+    /*
+      False after a malformed record.
+    */
+    bool good() const { return ok; };
+    size_t nextId() const { return next_id; };
+};
+
+/*
+  Sequential parser of a gzip-compressed read file. The decompressed
+  data are buffered up to the last record start, so that the records
+  before it are parsed by a ReadParser, the rest is kept for the next
+  batch. The views of a record are valid until the next call of next.
+*/
+class ReadStream{
+    GzipReader reader;
+    std::string buf;
+    size_t boundary; //buf[0, boundary) holds whole records
+    size_t scanned; //buf[0, scanned) is searched for record starts
+    size_t lines[2]; //starts of the last two lines before scanned
+    bool fastq;
+    bool ok;
+    bool eof;
+    ReadParser parser;
+
+    /*
+      Set boundary to the last record start (after 0) of the lines
+      starting in buf[scanned, buf.size()), if any, so that the bytes of
+      a record are searched once however many reads it takes.
+    */
+    void findRecordStarts();
+
+    /*
+      Drop the parsed records and decompress until buf holds a whole
+      record (or the end of the file), return false if none is left.
+    */
+    bool refill();
+
+public:
+    /*
+      --threads is the number of decompression threads (see GzipReader).
+    */
+    ReadStream(const char* filename, const int threads);
+
+    bool good();
+    bool next(ReadRecord& r);
+};
+
+#endif // ReadFile.h
@@ -0,0 +1,150 @@
+#include "SeedIndex.h"
+#include "ThreadPool.h"
+#include <thread>
+#include <algorithm>
+
+//byte b of a seed, b=0 is the least significant one
+static inline unsigned int seedByte(const kmer& x, const int b){
+    return (unsigned int)(x >> (b<<3)) & 255;
+}
+template<int W>
+static inline unsigned int seedByte(const LongKmer<W>& x, const int b){
+    return (x.w[b>>3] >> ((b&7)<<3)) & 255;
+}
+
+//number of bytes of a seed up to its most significant byte not 0
+static inline int seedBytes(const uint64_t x){
+    return x == 0 ? 0 : (71 - __builtin_clzll(x)) >> 3;
+}
+static inline int seedBytes(const kmer& x){
+    uint64_t hi = x >> 64;
+    return hi ? 8 + seedBytes(hi) : seedBytes((uint64_t)x);
+}
+template<int W>
+static inline int seedBytes(const LongKmer<W>& x){
+    for(int i=W-1; i>=0; --i){
+	if(x.w[i]) return (i<<3) + seedBytes(x.w[i]);
+    }
+    return 0;
+}
+
+template<class T>
+SeedIndex<T>::SeedIndex(const int threads/*=0*/):
+    num_threads(threads < 1 ? availableCpus() : threads), num_bytes(0){
+}
+
+template<class T>
+void SeedIndex<T>::add(const SeedT<T>* seeds, const size_t count,
+		       const int read_id){
+    int b;
+    for(size_t i=0; i<count; ++i){
+	occurrences.push_back({seeds[i].v, read_id, seeds[i].pos});
+	b = seedBytes(seeds[i].v);
+	if(b > num_bytes) num_bytes = b;
+    }
+}
+
+/*
+  One pass of the radix sort: each thread counts the byte b of its run of
+  in, then moves its run to out, after the runs of the threads before it
+  in each bucket (so that the pass is stable). Return false (and move
+  nothing) if all the occurrences have the same byte b.
+*/
+template<class T>
+static bool radixPass(const T* in, T* out, const size_t num, const int b,
+		      const int num_threads){
+    std::vector<size_t> counts(num_threads << 8, 0);
+    std::vector<std::thread> minions;
+    size_t run = (num + num_threads - 1) / num_threads;
+    int t, c;
+
+    auto countRun = [&](const int t){
+	size_t* ct = counts.data() + (t << 8);
+	size_t i, end = std::min(num, (t+1)*run);
+	for(i=t*run; i<end; ++i){
+	    ++ct[seedByte(in[i].v, b)];
+	}
+    };
+    for(t=1; t<num_threads; ++t){
+	minions.emplace_back(countRun, t);
+    }
+    countRun(0);
+    for(auto& x : minions){
+	x.join();
+    }
+    minions.clear();
+
+    //the offsets of the runs in out, by bucket then by thread
+    size_t total = 0, x;
+    for(c=0; c<256; ++c){
+	for(x=0, t=0; t<num_threads; ++t){
+	    x += counts[(t<<8)+c];
+	}
+	if(x == num) return false;
+    }
+    for(c=0; c<256; ++c){
+	for(t=0; t<num_threads; ++t){
+	    x = counts[(t<<8)+c];
+	    counts[(t<<8)+c] = total;
+	    total += x;
+	}
+    }
+
+    auto moveRun = [&](const int t){
+	size_t* ct = counts.data() + (t << 8);
+	size_t i, end = std::min(num, (t+1)*run);
+	for(i=t*run; i<end; ++i){
+	    out[ct[seedByte(in[i].v, b)]++] = in[i];
+	}
+    };
+    for(t=1; t<num_threads; ++t){
+	minions.emplace_back(moveRun, t);
+    }
+    moveRun(0);
+    for(auto& x : minions){
+	x.join();
+    }
+    return true;
+}
+
+template<class T>
+void SeedIndex<T>::sortOccurrences(){
+    size_t num = occurrences.size();
+    int threads = num / SEEDINDEXMINTHREADRUN;
+    if(threads > num_threads) threads = num_threads;
+    if(threads < 1) threads = 1;
+
+    std::vector<Occurrence> buf(num);
+    Occurrence* in = occurrences.data();
+    Occurrence* out = buf.data();
+    for(int b=0; b<num_bytes; ++b){
+	if(radixPass(in, out, num, b, threads)) std::swap(in, out);
+    }
+    if(in != occurrences.data()) occurrences.swap(buf);
+}
+
+template<class T>
+void SeedIndex<T>::build(const bool distinct_reads/*=false*/){
+    sortOccurrences();
+
+    size_t num = occurrences.size(), i;
+    ids.reserve(num);
+    pos.reserve(num);
+    for(i=0; i<num; ++i){
+	const Occurrence& o = occurrences[i];
+	if(i == 0 || o.v != occurrences[i-1].v){
+	    offsets.push_back(ids.size());
+	    distinct.push_back(o.v);
+	}else if(distinct_reads && o.read_id == ids.back()){
+	    continue;
+	}
+	ids.push_back(o.read_id);
+	pos.push_back(o.pos);
+    }
+    offsets.push_back(ids.size());
+    std::vector<Occurrence>().swap(occurrences);
+}
+
+//the k-mer types of the template above
+template class SeedIndex<kmer>;
+template class SeedIndex<longkmer>;
@@ -0,0 +1,85 @@
+/*
+  Inverted index of the seeds of many reads: for each distinct seed, the
+  reads (and positions) it occurs in, in place of a std::map from the
+  seeds to vectors of read ids (a tree node and a vector per distinct
+  seed).
+
+  The occurrences (seed, read id, position) are appended to a flat array
+  and grouped by a parallel LSD radix sort on the bytes of the seeds.
+  Only the bytes that are not 0 in some seed are sorted (i.e., about
+  ceil(2k/8) of them), and a byte shared by all the seeds is skipped.
+  The sort is stable, so with the reads added in ascending order of ids
+  (and the seeds of a read in ascending order of positions, as
+  generated), the occurrences of a seed stay in that order.
+
+  The index is then a CSR view: the distinct seeds in ascending order,
+  and the read ids and positions of the occurrences of seed i in
+  [offset(i), offset(i+1)) of two arrays.
+
+  Last edited: 10/16/2026
+*/
+
+#ifndef _SEEDINDEX_H
+#define _SEEDINDEX_H 1
+
+#include <cstddef>
+#include <vector>
+#include "util.h"
+
+#define SEEDINDEXMINTHREADRUN (1lu<<16) //fewest occurrences per thread
+
+template<class T>
+class SeedIndex{
+    struct Occurrence{
+	T v;
+	int read_id;
+	unsigned int pos;
+    };
+
+    int num_threads;
+    int num_bytes; //of the seeds that may not be 0
+    std::vector<Occurrence> occurrences; //until built
+    //the CSR view
+    std::vector<T> distinct;
+    std::vector<size_t> offsets;
+    std::vector<int> ids;
+    std::vector<unsigned int> pos;
+
+    void sortOccurrences();
+
+public:
+    /*
+      --threads used by the sort, availableCpus() if < 1.
+    */
+    explicit SeedIndex(const int threads=0);
+
+    /*
+      Add the seeds of a read, the reads are expected in ascending order
+      of ids.
+    */
+    void add(const SeedT<T>* seeds, const size_t count, const int read_id);
+
+    /*
+      Group the occurrences by seed, no seed can be added afterwards.
+      --distinct_reads keeps only the first occurrence of a seed in each
+        read.
+    */
+    void build(const bool distinct_reads=false);
+
+    //number of distinct seeds
+    size_t size() const { return distinct.size(); };
+    //number of occurrences
+    size_t numOccurrences() const { return ids.size(); };
+
+    const T& seed(const size_t i) const { return distinct[i]; };
+    size_t count(const size_t i) const { return offsets[i+1] - offsets[i]; };
+    //of the occurrences of seed i
+    const int* readIds(const size_t i) const{
+	return ids.data() + offsets[i];
+    };
+    const unsigned int* positions(const size_t i) const{
+	return pos.data() + offsets[i];
+    };
+};
+
+#endif // SeedIndex.h
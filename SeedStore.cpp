@@ -0,0 +1,526 @@
+#include "SeedStore.h"
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <zlib.h>
+
+static_assert(sizeof(SeedStoreHeader) == 64, "SeedStoreHeader is 64 bytes");
+
+uint64_t fileId(const char* filename){
+    FILE* fin = fopen(filename, "rb");
+    if(fin == NULL) return 0;
+    uint64_t h = 14695981039346656037ull;
+    unsigned char buf[1<<16];
+    size_t len, i;
+    while((len = fread(buf, 1, sizeof buf, fin)) > 0){
+	for(i=0; i<len; ++i){
+	    h = (h ^ buf[i]) * 1099511628211ull;
+	}
+    }
+    fclose(fin);
+    return h;
+}
+
+static inline void putVarint(std::string& out, uint64_t x){
+    while(x >= 128){
+	out += (char)(x | 128);
+	x >>= 7;
+    }
+    out += (char)x;
+}
+
+/*
+  Read a varint at p (not beyond ed) into x, p is moved past it. Return
+  false if it is cut off.
+*/
+static inline bool getVarint(const unsigned char*& p,
+			     const unsigned char* ed, uint64_t& x){
+    if(p < ed && *p < 128){//most are a single byte
+	x = *p++;
+	return true;
+    }
+    int shift = 0;
+    x = 0;
+    while(p < ed && shift < 64){
+	x |= (uint64_t)(*p & 127) << shift;
+	if(*p++ < 128) return true;
+	shift += 7;
+    }
+    return false;
+}
+
+/*
+  Bytes of a k-mer in a block.
+*/
+static inline size_t kmerBytes(const int k){
+    return (2*k + 7) >> 3;
+}
+
+/*
+  64-bit FNV-1a hash of the bytes of the input (of size bytes) within
+  SEEDSTOREPRINTBYTES of offset, 0 if they cannot be read.
+*/
+static uint64_t inputPrint(const int fd, const uint64_t offset,
+			   const uint64_t size){
+    unsigned char buf[SEEDSTOREPRINTBYTES<<1];
+    uint64_t st = offset > SEEDSTOREPRINTBYTES ? offset-SEEDSTOREPRINTBYTES : 0;
+    uint64_t len = std::min(offset+SEEDSTOREPRINTBYTES, size) - st;
+    if(fd < 0 || offset > size || pread(fd, buf, len, st) != (ssize_t)len){
+	return 0;
+    }
+    uint64_t h = 14695981039346656037ull;
+    for(uint64_t i=0; i<len; ++i){
+	h = (h ^ buf[i]) * 1099511628211ull;
+    }
+    return h;
+}
+
+/*
+  Write all of buf at offset, return false on an error.
+*/
+static bool pwriteAll(const int fd, const void* buf, size_t len,
+		      uint64_t offset){
+    const char* p = (const char*)buf;
+    ssize_t ret;
+    while(len > 0){
+	ret = pwrite(fd, p, len, offset);
+	if(ret <= 0) return false;
+	p += ret;
+	len -= ret;
+	offset += ret;
+    }
+    return true;
+}
+
+SeedStoreWriter::SeedStoreWriter(const char* filename, const int n,
+				 const int k, const size_t record_size,
+				 const uint64_t table_id,
+				 const double threshold,
+				 const bool deflate/*=false*/,
+				 const char* input_name/*=NULL*/,
+				 const bool resume/*=false*/):
+    fd(-1), checkpoint_name(std::string(filename) + ".checkpoint"),
+    input_fd(-1), input_size(0), end(sizeof(SeedStoreHeader)),
+    watermark(0), watermark_input(0), resumed(0),
+    last_checkpoint(std::chrono::steady_clock::now()), pending_bytes(0),
+    peak_blocks(0), peak_bytes(0), done(false), ok(true){
+    memset(&header, 0, sizeof header);
+    memcpy(header.magic, "SSSS", 4);
+    header.version = SEEDSTOREVERSION;
+    header.record_size = record_size;
+    header.n = n;
+    header.k = k;
+    header.table_id = table_id;
+    header.threshold = threshold;
+    header.flags = deflate ? SEEDSTOREDEFLATE : 0;
+
+    struct stat st;
+    if(input_name != NULL){
+	input_fd = open(input_name, O_RDONLY);
+	if(input_fd < 0 || fstat(input_fd, &st) != 0){
+	    fprintf(stderr, "Cannot open %s\n", input_name);
+	    ok = false;
+	    return;
+	}
+	input_size = st.st_size;
+    }
+    if(resume && stat(checkpoint_name.c_str(), &st) == 0){
+	fd = open(filename, O_RDWR);
+	if(fd < 0){
+	    fprintf(stderr, "Cannot open %s\n", filename);
+	    ok = false;
+	    return;
+	}
+	if(!resumeCheckpoint()){
+	    ok = false;
+	    return;
+	}
+    }else{
+	if(resume){
+	    fprintf(stderr, "No checkpoint of %s, starting over\n", filename);
+	}
+	fd = open(filename, O_CREAT | O_TRUNC | O_WRONLY, 0644);
+	//the header is rewritten by close, with index_offset set
+	if(fd < 0 || !pwriteAll(fd, &header, sizeof header, 0)){
+	    fprintf(stderr, "Cannot create %s\n", filename);
+	    ok = false;
+	    return;
+	}
+    }
+    minion = std::thread(&SeedStoreWriter::atWork, this);
+}
+
+SeedStoreWriter::~SeedStoreWriter(){
+    close();
+    if(input_fd >= 0) ::close(input_fd);
+}
+
+bool SeedStoreWriter::resumeCheckpoint(){
+    SeedStoreCheckpoint c;
+    SeedStoreHeader h;
+    FILE* fin = fopen(checkpoint_name.c_str(), "rb");
+    bool valid = fin != NULL && fread(&c, sizeof c, 1, fin) == 1
+	&& memcmp(c.magic, "SSCK", 4) == 0
+	&& c.version == SEEDSTORECHECKPOINTVERSION
+	&& c.data_end >= sizeof h && c.watermark <= c.num_reads;
+    if(valid){
+	index.resize(c.num_reads<<1);
+	input_ends.resize(c.num_reads);
+	valid = fread(index.data(), sizeof(uint64_t), index.size(), fin)
+	    == index.size()
+	    && fread(input_ends.data(), sizeof(uint64_t), input_ends.size(),
+		     fin) == input_ends.size();
+    }
+    if(fin) fclose(fin);
+    if(!valid){
+	fprintf(stderr, "Cannot read %s\n", checkpoint_name.c_str());
+	return false;
+    }
+
+    //the store must have been written with the same parameters
+    if(pread(fd, &h, sizeof h, 0) != sizeof h
+       || memcmp(h.magic, header.magic, 4) != 0
+       || h.version != header.version || h.record_size != header.record_size
+       || h.n != header.n || h.k != header.k || h.flags != header.flags
+       || h.table_id != header.table_id || h.threshold != header.threshold){
+	fprintf(stderr, "%s is of another store\n", checkpoint_name.c_str());
+	return false;
+    }
+    if(c.input_size != input_size
+       || c.input_print != inputPrint(input_fd, c.input_offset, input_size)){
+	fprintf(stderr, "%s is of another input\n", checkpoint_name.c_str());
+	return false;
+    }
+    //drop what was written after the checkpoint (and the index, if any)
+    if(ftruncate(fd, c.data_end) != 0
+       || !pwriteAll(fd, &header, sizeof header, 0)){
+	fprintf(stderr, "Cannot reset %s\n", checkpoint_name.c_str());
+	return false;
+    }
+
+    end = c.data_end;
+    watermark = resumed = c.watermark;
+    watermark_input = c.input_offset;
+    resumed_reads.resize(c.num_reads);
+    for(size_t i=0; i<c.num_reads; ++i){
+	resumed_reads[i] = index[i<<1] != 0;
+    }
+    return true;
+}
+
+template<class T>
+void SeedStoreWriter::append(const size_t read_id,
+			     const std::vector<SeedT<T> >& seeds,
+			     const uint64_t input_end/*=0*/){
+    if(hasRead(read_id)) return;
+
+    size_t c = seeds.size(), b = kmerBytes(header.k), i;
+    std::string block(1, 0);
+    unsigned int prev = 0;
+
+    //the (little-endian) low bytes of the seeds
+    putVarint(block, c);
+    block.resize(block.size() + c*b);
+    char* p = &block[block.size() - c*b];
+    for(i=0; i<c; ++i, p+=b){
+	memcpy(p, &seeds[i].v, b);
+    }
+    for(i=0; i<c; ++i){
+	putVarint(block, seeds[i].pos - prev);
+	prev = seeds[i].pos;
+    }
+    for(i=0; i<c; ++i){
+	putVarint(block, (seeds[i].span<<1) | seeds[i].strand);
+    }
+
+    if(header.flags & SEEDSTOREDEFLATE){
+	uLongf zlen = compressBound(block.size()-1);
+	std::string z(1, 1);
+	putVarint(z, block.size()-1);
+	size_t st = z.size();
+	z.resize(st + zlen);
+	if(compress2((Bytef*)&z[st], &zlen, (const Bytef*)block.data()+1,
+		     block.size()-1, Z_DEFAULT_COMPRESSION) == Z_OK
+	   && st + zlen < block.size()){
+	    z.resize(st + zlen);
+	    block.swap(z);
+	}
+    }
+
+    {
+	std::lock_guard<std::mutex> lock(door);
+	pending_bytes += block.size();
+	pending.push_back(Block{read_id, input_end, std::move(block)});
+	peak_blocks = std::max(peak_blocks, pending.size());
+	peak_bytes = std::max(peak_bytes, pending_bytes);
+    }
+    trumpet.notify_one();
+}
+
+bool SeedStoreWriter::writeAll(const std::string& buf){
+    if(!pwriteAll(fd, buf.data(), buf.size(), end)){
+	std::lock_guard<std::mutex> lock(door);
+	ok = false;
+	return false;
+    }
+    end += buf.size();
+    return true;
+}
+
+bool SeedStoreWriter::checkpoint(){
+    //the blocks must be on disk before a checkpoint refers to them
+    if(fdatasync(fd) != 0) return false;
+    while(watermark < input_ends.size() && index[watermark<<1] != 0){
+	watermark_input = input_ends[watermark];
+	++watermark;
+    }
+
+    SeedStoreCheckpoint c;
+    memset(&c, 0, sizeof c);
+    memcpy(c.magic, "SSCK", 4);
+    c.version = SEEDSTORECHECKPOINTVERSION;
+    c.watermark = watermark;
+    c.input_offset = watermark_input;
+    c.input_size = input_size;
+    c.input_print = inputPrint(input_fd, watermark_input, input_size);
+    c.data_end = end;
+    c.num_reads = input_ends.size();
+
+    std::string tmp = checkpoint_name + ".tmp";
+    FILE* fout = fopen(tmp.c_str(), "wb");
+    bool written = fout != NULL && fwrite(&c, sizeof c, 1, fout) == 1
+	&& fwrite(index.data(), sizeof(uint64_t), index.size(), fout)
+	== index.size()
+	&& fwrite(input_ends.data(), sizeof(uint64_t), input_ends.size(),
+		  fout) == input_ends.size()
+	&& fflush(fout) == 0 && fsync(fileno(fout)) == 0;
+    if(fout && fclose(fout) != 0) written = false;
+    if(!written || rename(tmp.c_str(), checkpoint_name.c_str()) != 0){
+	fprintf(stderr, "Cannot write %s\n", checkpoint_name.c_str());
+	return false;
+    }
+    last_checkpoint = std::chrono::steady_clock::now();
+    return true;
+}
+
+void SeedStoreWriter::atWork(){
+    std::vector<Block> blocks;
+    std::string buf;
+    size_t i;
+    std::unique_lock<std::mutex> lock(door);
+    while(true){
+	while(!done && pending.empty()){
+	    trumpet.wait(lock);
+	}
+	if(pending.empty()) return;
+
+	blocks.swap(pending);
+	pending_bytes = 0;
+	lock.unlock();
+	//coalesce the blocks into large sequential writes
+	buf.clear();
+	for(const Block& b : blocks){
+	    i = b.read_id - 1;
+	    if(input_ends.size() <= i){
+		input_ends.resize(i+1, 0);
+		index.resize((i+1)<<1, 0);
+	    }
+	    index[i<<1] = end + buf.size();
+	    index[(i<<1)+1] = b.data.size();
+	    input_ends[i] = b.input_end;
+	    buf += b.data;
+	    if(buf.size() >= SEEDSTOREWRITEBYTES){
+		writeAll(buf);
+		buf.clear();
+	    }
+	}
+	if(!buf.empty()) writeAll(buf);
+	blocks.clear();
+
+	if(std::chrono::steady_clock::now() - last_checkpoint
+	   >= std::chrono::seconds(SEEDSTORECHECKPOINTSECONDS)
+	   && !checkpoint()){
+	    lock.lock();
+	    ok = false;
+	    continue;
+	}
+	lock.lock();
+    }
+}
+
+bool SeedStoreWriter::close(){
+    if(fd < 0) return ok;
+    if(minion.joinable()){
+	{
+	    std::lock_guard<std::mutex> lock(door);
+	    done = true;
+	}
+	trumpet.notify_one();
+	minion.join();
+    }
+
+    ok = ok && checkpoint();
+    header.num_reads = input_ends.size();
+    header.index_offset = (end + 7) & ~7ull; //aligned for the reader
+    ok = ok && pwriteAll(fd, index.data(), index.size()*sizeof(uint64_t),
+			 header.index_offset)
+	&& pwriteAll(fd, &header, sizeof header, 0);
+    if(::close(fd) != 0) ok = false;
+    fd = -1;
+    if(!ok) fprintf(stderr, "Cannot write the seed store\n");
+    return ok;
+}
+
+SeedStore::SeedStore(const char* dir):
+    dir(dir), data(NULL), size(0), header(NULL), index(NULL), ok(true){
+    if(this->dir.empty() || this->dir.back() != '/') this->dir += '/';
+    std::string filename = this->dir + SEEDSTOREFILE;
+
+    int fd = open(filename.c_str(), O_RDONLY);
+    if(fd < 0) return; //one file per read
+    struct stat st;
+    if(fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(SeedStoreHeader)){
+	fprintf(stderr, "Cannot read %s\n", filename.c_str());
+	::close(fd);
+	ok = false;
+	return;
+    }
+    size = st.st_size;
+    void* p = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if(p == MAP_FAILED){
+	fprintf(stderr, "Cannot map %s\n", filename.c_str());
+	ok = false;
+	return;
+    }
+    data = (const char*)p;
+    header = (const SeedStoreHeader*)data;
+
+    if(memcmp(header->magic, "SSSS", 4) != 0
+       || header->version != SEEDSTOREVERSION){
+	fprintf(stderr, "%s is not a seed store\n", filename.c_str());
+	ok = false;
+    }else if(header->index_offset < sizeof(SeedStoreHeader)
+	     || header->index_offset % 8 != 0 || header->index_offset > size
+	     || (size - header->index_offset) / (2*sizeof(uint64_t))
+	     < header->num_reads){
+	fprintf(stderr, "%s is incomplete\n", filename.c_str());
+	ok = false;
+    }else{
+	index = (const uint64_t*)(data + header->index_offset);
+	madvise(p, size, MADV_WILLNEED);
+    }
+}
+
+SeedStore::~SeedStore(){
+    if(data) munmap((void*)data, size);
+}
+
+/*
+  Decode the c seeds of a block from p (not beyond ed) into seeds, b
+  bytes per k-mer. Return false if the block is cut off.
+*/
+template<class T>
+static bool decodeSeeds(const unsigned char* p, const unsigned char* ed,
+			const size_t c, const size_t b, SeedT<T>* seeds){
+    size_t i;
+    uint64_t x;
+    unsigned int pos = 0;
+
+    if((size_t)(ed - p) < c*b) return false;
+    for(i=0; i<c; ++i, p+=b){
+	T v = 0;
+	memcpy(&v, p, b);
+	seeds[i].v = v;
+    }
+    for(i=0; i<c; ++i){
+	if(!getVarint(p, ed, x)) return false;
+	pos += x;
+	seeds[i].pos = pos;
+    }
+    for(i=0; i<c; ++i){
+	if(!getVarint(p, ed, x)) return false;
+	seeds[i].span = x >> 1;
+	seeds[i].strand = x & 1;
+    }
+    return true;
+}
+
+template<class T>
+const SeedT<T>* SeedStore::getSeeds(const size_t read_id, size_t& count){
+    count = 0;
+    if(!ok) return NULL;
+
+    if(data == NULL){//one file per read
+	std::string filename = dir + std::to_string(read_id) + ".subseqseed";
+	FILE* fin = fopen(filename.c_str(), "rb");
+	if(fin == NULL) return NULL;
+	struct stat st;
+	fstat(fileno(fin), &st);
+	count = st.st_size / sizeof(SeedT<T>);
+	buf.resize(count * sizeof(SeedT<T>) + 1);
+	if(fread(buf.data(), sizeof(SeedT<T>), count, fin) != count){
+	    fprintf(stderr, "Error reading %s\n", filename.c_str());
+	    count = 0;
+	}
+	fclose(fin);
+	return (const SeedT<T>*)buf.data();
+    }
+
+    if(header->record_size != sizeof(SeedT<T>)){
+	fprintf(stderr, "The seeds are stored with another k-mer type"
+		" (k > 64?)\n");
+	ok = false;
+	return NULL;
+    }
+    if(read_id < 1 || read_id > header->num_reads) return NULL;
+    uint64_t offset = index[(read_id-1)<<1];
+    uint64_t len = index[((read_id-1)<<1)+1], x;
+    if(offset == 0) return NULL;
+
+    const unsigned char* p = (const unsigned char*)data + offset;
+    const unsigned char* ed = p + len;
+    bool valid = len > 0 && offset + len <= header->index_offset;
+    if(valid && *p++ == 1){//deflated
+	uLongf inflated_len;
+	//deflate cannot shrink by more than about 1032 times
+	valid = getVarint(p, ed, x) && x <= (uint64_t)(ed-p)*1032 + 64;
+	if(valid) inflated.resize(x);
+	inflated_len = x;
+	valid = valid && uncompress((Bytef*)&inflated[0], &inflated_len,
+				    p, ed-p) == Z_OK && inflated_len == x;
+	p = (const unsigned char*)inflated.data();
+	ed = p + inflated_len;
+    }
+    //a seed takes at least 3 bytes
+    valid = valid && getVarint(p, ed, x) && x <= (uint64_t)(ed-p)/3;
+    if(valid){
+	count = x;
+	//+1: not NULL for a read without seeds
+	buf.resize(count * sizeof(SeedT<T>) + 1);
+	valid = decodeSeeds(p, ed, count, kmerBytes(header->k),
+			    (SeedT<T>*)buf.data());
+    }
+    if(!valid){
+	fprintf(stderr, "The seeds of read %zu are corrupted\n", read_id);
+	count = 0;
+	ok = false;
+	return NULL;
+    }
+    return (const SeedT<T>*)buf.data();
+}
+
+//the k-mer types of the templates above
+#define INSTANTIATE(T) \
+    template void SeedStoreWriter::append<T>( \
+	const size_t read_id, const std::vector<SeedT<T> >& seeds, \
+	const uint64_t input_end); \
+    template const SeedT<T>* SeedStore::getSeeds<T>(const size_t read_id, \
+						    size_t& count);
+
+INSTANTIATE(kmer)
+INSTANTIATE(longkmer)
@@ -0,0 +1,260 @@
+/*
+  All the seeds of a read file (with one table) in a single file, instead
+  of a file per read, so that neither the seeding nor the loading opens
+  a file per read.
+
+  The store is laid out as:
+  --a SeedStoreHeader;
+  --the seeds of each read as a block, in the order they were appended
+    (i.e., not by read id);
+  --the index: for each read id 1..num_reads, the offset of its block
+    (0 if the read was never appended) and its length in bytes.
+  The index is written when the writer is closed, a store without it
+  (e.g., of an interrupted run) cannot be loaded.
+
+  A block is a byte, 1 if the rest is deflated (then followed by the
+  varint length of the inflated data) or 0, then:
+  --the varint number of seeds c;
+  --the c seeds, each in its ceil(2k/8) low bytes (little-endian);
+  --the c positions, each as the varint difference to the previous one
+    (modulo 2^32, the seeds of a read are in ascending order of
+    positions);
+  --the c varints span<<1 | strand.
+  Each field is a run of its own so that a loader decodes it in a tight
+  loop. A seed thus takes about ceil(2k/8)+2 bytes instead of the 32 (or
+  48 for k > 64) bytes of a SeedT. Blocks are deflated (by zlib) only if
+  the store is written with deflate and it makes them smaller.
+
+  A SeedStore also reads the seed directories of one file per read
+  (<dir>/<id>.subseqseed) when there is no store in the directory.
+
+  Last edited: 10/16/2026
+*/
+
+#ifndef _SEEDSTORE_H
+#define _SEEDSTORE_H 1
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <utility>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include "util.h"
+
+#define SEEDSTOREFILE "seeds.subseqstore"
+#define SEEDSTOREVERSION 2
+#define SEEDSTOREDEFLATE 1 //flag of blocks that may be deflated
+#define SEEDSTOREWRITEBYTES (1lu<<22) //the largest single write
+#define SEEDSTORECHECKPOINTSECONDS 60
+#define SEEDSTORECHECKPOINTVERSION 4
+#define SEEDSTOREPRINTBYTES 256 //of the input on each side of the offset
+
+struct SeedStoreHeader{
+    char magic[4]; //"SSSS"
+    uint32_t version;
+    uint32_t record_size; //sizeof(SeedT<T>), differs for k > 64
+    int32_t n;
+    int32_t k;
+    uint32_t flags; //SEEDSTOREDEFLATE
+    uint64_t table_id; //see fileId
+    double threshold;
+    uint64_t num_reads;
+    uint64_t index_offset; //0 until the writer is closed
+    uint64_t reserved;
+};
+
+/*
+  64-bit FNV-1a hash of the content of a file (e.g., of a random table),
+  0 if it cannot be read.
+*/
+uint64_t fileId(const char* filename);
+
+/*
+  Checkpoint of a store being written (in <store>.checkpoint), followed
+  by the index of reads 1..num_reads as in the store, then by the end of
+  each of these reads in the input (0 if unknown).
+*/
+struct SeedStoreCheckpoint{
+    char magic[4]; //"SSCK"
+    uint32_t version;
+    uint64_t watermark; //reads 1..watermark are in the store
+    uint64_t input_offset; //of the input, right after read watermark
+    uint64_t input_size; //of the whole input
+    uint64_t input_print; //hash of the input bytes around input_offset
+    uint64_t data_end; //end of the blocks of the checkpoint
+    uint64_t num_reads; //reads after the watermark may be in it as well
+};
+
+/*
+  Writer of a store, its append can be called by several threads at
+  once. append only encodes the seeds and queues the block, the blocks
+  are written by a thread of the writer: all the blocks queued while it
+  was writing are written together, in writes of up to
+  SEEDSTOREWRITEBYTES bytes at the end of the file. The callers thus
+  never wait for the file system.
+
+  Every SEEDSTORECHECKPOINTSECONDS (and when closed), after a pass of
+  writes, the writer thread syncs the store and commits a checkpoint:
+  the index of the reads written so far, the watermark, i.e., the
+  largest w such that reads 1..w are written, where read w+1 starts in
+  the input and a hash of the input bytes around it, so that a resumed
+  run can start there without parsing the reads before it. It is written to a temporary file renamed over the
+  previous one, so that a checkpoint is either the old one or the new
+  one. A store reopened with resume is cut back to its checkpoint, the
+  reads it has (see hasRead) are not to be appended again. The reads
+  complete out of order, so there may be many of them after the
+  watermark.
+*/
+class SeedStoreWriter{
+    //a block queued for the writer thread
+    struct Block{
+	size_t read_id;
+	uint64_t input_end;
+	std::string data;
+    };
+
+    int fd;
+    SeedStoreHeader header;
+    std::string checkpoint_name;
+    int input_fd; //-1 if the input is not known
+    uint64_t input_size;
+    uint64_t end; //of the data written so far
+    //of the writer thread: (offset, length) and the end of the read in
+    //the input, by read id - 1, the offset is 0 for the reads not
+    //written yet
+    std::vector<uint64_t> index;
+    std::vector<uint64_t> input_ends;
+    size_t watermark;
+    uint64_t watermark_input;
+    size_t resumed; //watermark of the checkpoint resumed from
+    std::vector<bool> resumed_reads; //the reads of that checkpoint
+    std::chrono::steady_clock::time_point last_checkpoint;
+    //blocks queued for the writer thread
+    std::vector<Block> pending;
+    size_t pending_bytes;
+    size_t peak_blocks, peak_bytes;
+    bool done;
+    bool ok;
+    std::thread minion;
+    std::mutex door;
+    std::condition_variable trumpet;
+
+    void atWork();
+    bool writeAll(const std::string& buf);
+    bool checkpoint();
+    bool resumeCheckpoint();
+
+public:
+    /*
+      Create (or truncate) the store, good() is false (with a message on
+      stderr) if it cannot be created.
+      --deflate lets the blocks be deflated;
+      --input_name is the read file, to check a checkpoint is resumed on
+        the same input (by its size and the bytes around the watermark);
+      --resume reopens the store at its checkpoint instead, a store
+        without a checkpoint is started over. good() is false if the
+        checkpoint is of another store (e.g., other n) or input.
+    */
+    SeedStoreWriter(const char* filename, const int n, const int k,
+		    const size_t record_size, const uint64_t table_id,
+		    const double threshold, const bool deflate=false,
+		    const char* input_name=NULL, const bool resume=false);
+    //closes the store if not yet closed, and the input
+    ~SeedStoreWriter();
+    SeedStoreWriter(const SeedStoreWriter&) = delete;
+    SeedStoreWriter& operator = (const SeedStoreWriter&) = delete;
+
+    bool good(){
+	std::lock_guard<std::mutex> lock(door);
+	return ok;
+    };
+
+    /*
+      The watermark of the checkpoint resumed from (0 if none) and the
+      offset of the input right after that read.
+    */
+    size_t resumedReads() const { return resumed; };
+    uint64_t resumedInputOffset() const { return watermark_input; };
+
+    /*
+      Whether the checkpoint resumed from has the read.
+    */
+    bool hasRead(const size_t read_id) const{
+	return read_id <= resumed || (read_id <= resumed_reads.size()
+				      && resumed_reads[read_id-1]);
+    };
+
+    /*
+      The largest number of blocks (and of their bytes) waiting for the
+      writer thread so far.
+    */
+    void queueDepth(size_t& blocks, size_t& bytes){
+	std::lock_guard<std::mutex> lock(door);
+	blocks = peak_blocks;
+	bytes = peak_bytes;
+    };
+
+    /*
+      Write the seeds of a read, each read is appended at most once (the
+      reads of hasRead are ignored). The positions take the
+      fewest bytes in ascending order (as generated).
+      --input_end is where the read ends in the input (see ReadRecord).
+    */
+    template<class T>
+    void append(const size_t read_id, const std::vector<SeedT<T> >& seeds,
+		const uint64_t input_end=0);
+
+    /*
+      Wait for the queued blocks to be written, then write the index, the
+      header and a last checkpoint. Return false if any write failed.
+    */
+    bool close();
+};
+
+/*
+  Reader of the store of a seed directory (mapped in memory), or of its
+  files of one read each if it has no store.
+*/
+class SeedStore{
+    std::string dir;
+    const char* data;
+    size_t size;
+    const SeedStoreHeader* header;
+    const uint64_t* index;
+    std::vector<char> buf; //the seeds of the last read
+    std::string inflated; //the last deflated block
+    bool ok;
+
+public:
+    /*
+      good() is false (with a message on stderr) if the store of dir
+      cannot be read or is incomplete.
+    */
+    explicit SeedStore(const char* dir);
+    ~SeedStore();
+    SeedStore(const SeedStore&) = delete;
+    SeedStore& operator = (const SeedStore&) = delete;
+
+    bool good() const { return ok; };
+    //false if the seeds are in one file per read
+    bool isStore() const { return data != NULL; };
+    //0 for one file per read
+    size_t numReads() const { return data ? header->num_reads : 0; };
+    //k of the stored seeds, 0 for one file per read
+    int k() const { return data ? header->k : 0; };
+
+    /*
+      The seeds of a read (count of them), decoded, NULL if the read has
+      none stored (i.e., no file) or on an error. A read stored without
+      seeds (e.g., shorter than n) is not NULL, with count 0. Valid until
+      the next call. T must be the k-mer type the seeds were stored with.
+    */
+    template<class T>
+    const SeedT<T>* getSeeds(const size_t read_id, size_t& count);
+};
+
+#endif // SeedStore.h
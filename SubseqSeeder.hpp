@@ -0,0 +1,140 @@
+/*
+  Seeding kernels specialized at compile time for a fixed pair (n, k).
+  The dp tables are fixed-size members and all band bounds are constants,
+  so the hot loops carry no runtime loop-bound computation or VLAs. The
+  results are identical to getSubseqSeedsThresholdTwoTier (hence to
+  getSubseqSeedsThreshold).
+
+  Last edited: 10/16/2026
+*/
+
+#ifndef _SUBSEQSEEDER_H
+#define _SUBSEQSEEDER_H 1
+
+#include <memory>
+#include "util.h"
+
+/*
+  The (n, k) pairs that get a specialized seeder, as a list of X(n, k).
+  Can be overridden at compile time, e.g.,
+  -D'SUBSEQSEEDER_PARAMS=X(60,42) X(30,24)'.
+*/
+#ifndef SUBSEQSEEDER_PARAMS
+#define SUBSEQSEEDER_PARAMS X(60, 42) X(30, 24)
+#endif
+
+template<int N, int K>
+class SubseqSeeder{
+    static_assert(K >= 1 && N >= K, "SubseqSeeder needs 1 <= K <= N");
+
+    /*
+      The dp table of N+1 chars is kept row by row, with the band of row i
+      contiguous: [i][j] is at i*W + W-1-(i-j). The first slot of row i
+      stands for [i-1][i] (i.e., not meaningful) and holds -/+1e15 so that
+      no cell needs a special case. The tables of the first N chars use
+      the same places. The traceback bits (DPTRACE*) take a byte per cell.
+    */
+    static constexpr int W = N-K+3;
+    static constexpr int CELLS = (N+2)*W;
+
+    //random tables folded into +/-1 and +/-A (see scoreDPTable) and
+    //transposed, so that a row of the dp reads them contiguously
+    double sb[ALPHABETSIZE][K], sa[ALPHABETSIZE][K];
+    double bound[K+1];
+    bool use_bound;
+
+    double row_min[2][K+1], row_max[2][K+1];
+    double min[CELLS], max[CELLS];
+    uint8_t trace[CELLS];
+
+    /*
+      Same as scoreDPTable on the first M chars of s, S is const char*
+      or PackedSeq (see util.h).
+    */
+    template<int M, class S>
+    double score(const S& s, double* prev_score, const double threshold);
+
+    /*
+      Same as fillDPTable on the first M chars of s.
+    */
+    template<int M, class S>
+    void fill(const S& s);
+
+    /*
+      Same as backtrackDPTable from [M][K] after fill<N+1> or fill<N>.
+    */
+    template<int M, class T, class S>
+    bool backtrack(const S& s, T* result) const;
+
+    //getSeeds on the len chars from s
+    template<class T, class S>
+    void getSeedsOf(const S& s, const size_t len, const double threshold,
+		    std::vector<SeedT<T> >& seeds_list, SeedingStats* stats);
+
+public:
+    /*
+      --tp is RandTableCell[K][ALPHABETSIZE] flattened;
+      --bound (from initSuffixBounds) enables branch-and-bound pruning.
+    */
+    SubseqSeeder(const RandTableCell* tp, const double* bound=NULL);
+
+    /*
+      Same as getSubseqSeedsThresholdTwoTier with n=N and k=K.
+    */
+    template<class T>
+    void getSeeds(const std::string& read, const double threshold,
+		  std::vector<SeedT<T> >& seeds_list, SeedingStats* stats=NULL);
+
+    /*
+      Same as above on the len chars of a packed read from s, the
+      positions of the seeds are relative to s.
+    */
+    template<class T>
+    void getSeeds(const PackedSeq& s, const size_t len, const double threshold,
+		  std::vector<SeedT<T> >& seeds_list, SeedingStats* stats=NULL);
+};
+
+/*
+  A seeder of one table for a given (n, k), T is the k-mer type (see
+  util.h). It is built once (e.g., per thread and table, see
+  makeSubseqSeeder) and reused for all the reads, so that the tables are
+  folded only once.
+*/
+template<class T>
+class SubseqSeedsKernel{
+public:
+    virtual ~SubseqSeedsKernel() {};
+
+    /*
+      Same as getSubseqSeedsThresholdTwoTier with the n, k, table and
+      bound of the seeder.
+    */
+    virtual void getSeeds(const std::string& read, const double threshold,
+			  std::vector<SeedT<T> >& seeds_list,
+			  SeedingStats* stats=NULL) = 0;
+
+    /*
+      Same as above on the len chars of a packed read from s (see
+      PackedSeq), the positions of the seeds are relative to s.
+    */
+    virtual void getSeeds(const PackedSeq& s, const size_t len,
+			  const double threshold,
+			  std::vector<SeedT<T> >& seeds_list,
+			  SeedingStats* stats=NULL) = 0;
+};
+
+/*
+  The seeder of (n, k) from SUBSEQSEEDER_PARAMS, or one calling the
+  generic getSubseqSeedsThresholdTwoTier if (n, k) is not in the list.
+  tp and bound are as for SubseqSeeder, tp (and bound) must outlive the
+  generic seeder.
+  --specialized is set to whether a specialized seeder is found.
+*/
+template<class T=kmer>
+std::unique_ptr<SubseqSeedsKernel<T> > makeSubseqSeeder(
+    const int n, const int k, const RandTableCell* tp,
+    const double* bound=NULL, bool* specialized=NULL);
+
+#include "SubseqSeeder.tpp"
+
+#endif // SubseqSeeder.hpp
@@ -0,0 +1,311 @@
+//-*-C-*- for emacs
+
+#include <cmath>
+
+template<int N, int K>
+SubseqSeeder<N, K>::SubseqSeeder(const RandTableCell* tp,
+				 const double* bound/*=NULL*/):
+    use_bound(bound != NULL){
+    int i, c, q;
+    for(i=0; i<K; ++i){
+	for(c=0; c<ALPHABETSIZE; ++c){
+	    q = access2d(ALPHABETSIZE, i, c);
+	    sb[c][i] = (tp[q].B1<<1) - 1;
+	    sa[c][i] = ((tp[q].B2<<1) - 1) * tp[q].A;
+	}
+    }
+    if(bound) memcpy(this->bound, bound, sizeof this->bound);
+    
+    //neither is ever written by fill
+    for(i=0; i<N+2; ++i){
+	min[i*W] = 1e15;
+	max[i*W] = -1e15;
+	if(i <= N+1-K){//column 0, nothing selected yet
+	    min[i*W+W-1-i] = max[i*W+W-1-i] = 0;
+	}
+    }
+}
+
+template<int N, int K>
+template<int M, class S>
+double SubseqSeeder<N, K>::score(const S& s, double* prev_score,
+				 const double threshold){
+    constexpr int del = M-K;
+    int i, j, c, minj, maxj;
+    double* pmn = row_min[0];
+    double* pmx = row_max[0];
+    double* cmn = row_min[1];
+    double* cmx = row_max[1];
+    double v1, v2, lo, hi, best;
+
+    memset(row_min, 0, sizeof row_min);
+    memset(row_max, 0, sizeof row_max);
+    c = baseAt(s, 0);
+    pmn[1] = pmx[1] = sa[c][0];
+
+    //same values as scoreDPTable, but row i is computed from row i-1
+    //in a separate array so that the loop over j can be vectorized
+    for(i=2; i<=M; ++i){
+	if(i == M && prev_score){
+	    v1 = fabs(pmn[K]);
+	    *prev_score = v1 < pmx[K] ? pmx[K] : v1;
+	}
+	minj = i-del > 1 ? i-del : 1;
+	maxj = i < K ? i : K;
+	c = baseAt(s, i-1);
+	const double* b = sb[c];
+	const double* a = sa[c];
+
+	if(i <= K){//[i-1][i] is not a meaningful cell
+	    pmn[i] = 1e15;
+	    pmx[i] = -1e15;
+	}
+	for(j=minj; j<=maxj; ++j){
+	    v1 = b[j-1] * pmn[j-1] + a[j-1];
+	    v2 = b[j-1] * pmx[j-1] + a[j-1];
+	    lo = v1 < v2 ? v1 : v2;
+	    hi = v1 < v2 ? v2 : v1;
+	    cmn[j] = lo < pmn[j] ? lo : pmn[j];
+	    cmx[j] = hi > pmx[j] ? hi : pmx[j];
+	}
+	std::swap(pmn, cmn);
+	std::swap(pmx, cmx);
+
+	if(use_bound && i < M){
+	    for(j=minj, best=(i<=del ? bound[0] : 0); j<=maxj; ++j){
+		v1 = (-pmn[j] < pmx[j] ? pmx[j] : -pmn[j]) + bound[j];
+		best = v1 > best ? v1 : best;
+	    }
+	    if(best * (1+1e-12) < threshold){
+		if(prev_score) *prev_score = -1;
+		return -1;
+	    }
+	}
+    }
+
+    v1 = fabs(pmn[K]);
+    return v1 < pmx[K] ? pmx[K] : v1;
+}
+
+template<int N, int K>
+template<int M, class S>
+void SubseqSeeder<N, K>::fill(const S& s){
+    static_assert(M <= N+1, "SubseqSeeder::fill beyond N+1 chars");
+    constexpr int del = M-K;
+    int i, j, c, q, minj, maxj;
+    double v1, v2, lo, hi, cur_min, cur_max;
+    bool lt, tmin, tmax;
+
+    for(i=1; i<=M; ++i){
+	minj = i-del > 1 ? i-del : 1;
+	maxj = i < K ? i : K;
+	c = baseAt(s, i-1);
+	const double* b = sb[c];
+	const double* a = sa[c];
+
+	//[i-1][j-1] is at q-W, [i-1][j] at q-W+1
+	for(j=minj, q=i*W+W-1-i+minj; j<=maxj; ++j, ++q){
+	    cur_min = min[q-W+1];
+	    cur_max = max[q-W+1];
+	    v1 = b[j-1] * min[q-W] + a[j-1];
+	    v2 = b[j-1] * max[q-W] + a[j-1];
+	    lt = v1 < v2;
+	    lo = lt ? v1 : v2;
+	    hi = lt ? v2 : v1;
+	    tmin = lo <= cur_min;
+	    tmax = hi >= cur_max;
+	    min[q] = tmin ? lo : cur_min;
+	    max[q] = tmax ? hi : cur_max;
+	    //a value kept from [i-1][j] is its max (resp. min)
+	    trace[q] = (tmax ? DPTRACE_MAXPRE | (lt ? DPTRACE_MAXMAX : 0)
+			: DPTRACE_MAXMAX)
+		| (tmin ? DPTRACE_MINPRE | (lt ? 0 : DPTRACE_MINMAX) : 0);
+	}
+    }
+}
+
+template<int N, int K>
+template<int M, class T, class S>
+bool SubseqSeeder<N, K>::backtrack(const S& s, T* result) const{
+    *result = 0;
+    int i = 0, cur = M;
+    int q = M*W + W-1-(M-K);
+    bool select, from_max;
+    uint8_t t = trace[q];
+
+    if(max[q] > fabs(min[q])){
+	select = t & DPTRACE_MAXPRE;
+	from_max = t & DPTRACE_MAXMAX;
+    }else{
+	select = t & DPTRACE_MINPRE;
+	from_max = t & DPTRACE_MINMAX;
+    }
+
+    while(i < (K<<1)){
+	if(select){
+	    setKmerBase(*result, i, baseAt(s, cur-1));
+	    i += 2;
+	    q -= W; //[i][j] to [i-1][j-1]
+	}else{
+	    q -= W-1; //[i][j] to [i-1][j]
+	}
+	cur -= 1;
+
+	t = trace[q];
+	if(from_max){
+	    select = t & DPTRACE_MAXPRE;
+	    from_max = t & DPTRACE_MAXMAX;
+	}else{
+	    select = t & DPTRACE_MINPRE;
+	    from_max = t & DPTRACE_MINMAX;
+	}
+    }
+
+    return (q == W-1); //[0][0]
+}
+
+template<int N, int K>
+template<class T, class S>
+void SubseqSeeder<N, K>::getSeedsOf(const S& s, const size_t len,
+				    const double threshold,
+				    std::vector<SeedT<T> >& seeds_list,
+				    SeedingStats* stats){
+    if(len < (size_t)N) return;
+
+    unsigned int i;
+    T seed;
+    double score_n, score_n1;
+    SeedingStats local;
+
+    local.windows = len - N + 1;
+    for(i=0; i<len-N; i+=1){
+	score_n1 = score<N+1>(s+i, &score_n, threshold);
+	if(score_n1 < threshold){//neither window i nor i+1 has a seed
+	    if(score_n1 < 0) local.pruned += 2;
+	    ++i;
+	    continue;
+	}
+
+	fill<N+1>(s+i);
+	if(score_n >= threshold){
+	    backtrack<N>(s+i, &seed);
+	    storeSeedWithPosInVector(seed, i, seeds_list);
+	}
+	if(!backtrack<N+1>(s+i, &seed)){//first char not used
+	    ++i;
+	    storeSeedWithPosInVector(seed, i, seeds_list);
+	}
+    }
+
+    //last window, see getSubseqSeedsThreshold
+    if(i == len - N){
+	score_n = score<N>(s+i, NULL, threshold);
+	if(score_n >= threshold){
+	    fill<N>(s+i);
+	    backtrack<N>(s+i, &seed);
+	    storeSeedWithPosInVector(seed, i, seeds_list);
+	}else if(score_n < 0){
+	    local.pruned += 1;
+	}
+    }
+
+    if(stats) *stats += local;
+}
+
+template<int N, int K>
+template<class T>
+void SubseqSeeder<N, K>::getSeeds(const std::string& read,
+				  const double threshold,
+				  std::vector<SeedT<T> >& seeds_list,
+				  SeedingStats* stats/*=NULL*/){
+    getSeedsOf(read.c_str(), read.length(), threshold, seeds_list, stats);
+}
+
+template<int N, int K>
+template<class T>
+void SubseqSeeder<N, K>::getSeeds(const PackedSeq& s, const size_t len,
+				  const double threshold,
+				  std::vector<SeedT<T> >& seeds_list,
+				  SeedingStats* stats/*=NULL*/){
+    getSeedsOf(s, len, threshold, seeds_list, stats);
+}
+
+/***** DISPATCH *****/
+template<int N, int K, class T>
+class SubseqSeederKernel : public SubseqSeedsKernel<T>{
+    SubseqSeeder<N, K> seeder;
+
+public:
+    SubseqSeederKernel(const RandTableCell* tp, const double* bound):
+	seeder(tp, bound) {};
+
+    void getSeeds(const std::string& read, const double threshold,
+		  std::vector<SeedT<T> >& seeds_list,
+		  SeedingStats* stats=NULL) override{
+	seeder.getSeeds(read, threshold, seeds_list, stats);
+    }
+
+    void getSeeds(const PackedSeq& s, const size_t len,
+		  const double threshold, std::vector<SeedT<T> >& seeds_list,
+		  SeedingStats* stats=NULL) override{
+	seeder.getSeeds(s, len, threshold, seeds_list, stats);
+    }
+
+    static std::unique_ptr<SubseqSeedsKernel<T> > make(
+	const RandTableCell* tp, const double* bound){
+	return std::unique_ptr<SubseqSeedsKernel<T> >(
+	    new SubseqSeederKernel<N, K, T>(tp, bound));
+    }
+};
+
+template<class T>
+class TwoTierKernel : public SubseqSeedsKernel<T>{
+    const int n, k;
+    const RandTableCell* tp;
+    const double* bound;
+
+public:
+    TwoTierKernel(const int n, const int k, const RandTableCell* tp,
+		  const double* bound):
+	n(n), k(k), tp(tp), bound(bound) {};
+
+    void getSeeds(const std::string& read, const double threshold,
+		  std::vector<SeedT<T> >& seeds_list,
+		  SeedingStats* stats=NULL) override{
+	getSubseqSeedsThresholdTwoTier(read, n, k, tp, threshold, seeds_list,
+				       bound, stats);
+    }
+
+    void getSeeds(const PackedSeq& s, const size_t len,
+		  const double threshold, std::vector<SeedT<T> >& seeds_list,
+		  SeedingStats* stats=NULL) override{
+	getSubseqSeedsThresholdTwoTier(s, len, n, k, tp, threshold,
+				       seeds_list, bound, stats);
+    }
+};
+
+template<class T>
+inline std::unique_ptr<SubseqSeedsKernel<T> > makeSubseqSeeder(
+    const int n, const int k, const RandTableCell* tp,
+    const double* bound/*=NULL*/, bool* specialized/*=NULL*/){
+    typedef std::unique_ptr<SubseqSeedsKernel<T> > (*Maker)(
+	const RandTableCell*, const double*);
+    static const struct{
+	int n, k;
+	Maker make;
+    } seeders[] = {
+#define X(n, k) {n, k, SubseqSeederKernel<n, k, T>::make},
+	SUBSEQSEEDER_PARAMS
+#undef X
+    };
+
+    for(const auto& e : seeders){
+	if(e.n == n && e.k == k){
+	    if(specialized) *specialized = true;
+	    return e.make(tp, bound);
+	}
+    }
+    if(specialized) *specialized = false;
+    return std::unique_ptr<SubseqSeedsKernel<T> >(
+	new TwoTierKernel<T>(n, k, tp, bound));
+}
@@ -0,0 +1,205 @@
+#include "ThreadPool.h"
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <sched.h>
+#include <pthread.h>
+
+/*
+  The cpu quota of the cgroup of the process in cpus (rounded up), -1 if
+  there is none.
+*/
+static int cgroupCpuQuota(){
+    char path[512] = "/sys/fs/cgroup/cpu.max", line[512], quota[32];
+    long long q = -1, period = 0;
+    FILE* fin;
+
+    //cgroup v2: "0::/path" in /proc/self/cgroup
+    if((fin = fopen("/proc/self/cgroup", "r")) != NULL){
+	while(fgets(line, sizeof line, fin)){
+	    if(strncmp(line, "0::", 3) == 0){
+		line[strcspn(line, "\n")] = '\0';
+		snprintf(path, sizeof path, "/sys/fs/cgroup%s/cpu.max",
+			 strcmp(line+3, "/") ? line+3 : "");
+		break;
+	    }
+	}
+	fclose(fin);
+    }
+    if((fin = fopen(path, "r")) != NULL
+       || (fin = fopen("/sys/fs/cgroup/cpu.max", "r")) != NULL){
+	if(fscanf(fin, "%31s %lld", quota, &period) == 2
+	   && strcmp(quota, "max") != 0){
+	    q = atoll(quota);
+	}
+	fclose(fin);
+    }else if((fin = fopen("/sys/fs/cgroup/cpu/cpu.cfs_quota_us", "r"))
+	     != NULL){//cgroup v1
+	if(fscanf(fin, "%lld", &q) != 1) q = -1;
+	fclose(fin);
+	if((fin = fopen("/sys/fs/cgroup/cpu/cpu.cfs_period_us", "r"))
+	   != NULL){
+	    if(fscanf(fin, "%lld", &period) != 1) period = 0;
+	    fclose(fin);
+	}
+    }
+
+    if(q <= 0 || period <= 0) return -1;
+    return (q + period - 1) / period;
+}
+
+//the index of the worker of the thread, see currentWorker
+static thread_local int worker_index = -1;
+
+int availableCpus(){
+    cpu_set_t set;
+    int n = 0, quota = cgroupCpuQuota();
+    if(sched_getaffinity(0, sizeof set, &set) == 0) n = CPU_COUNT(&set);
+    if(n < 1) n = std::thread::hardware_concurrency();
+    if(quota > 0 && quota < n) n = quota;
+    return n < 1 ? 1 : n;
+}
+
+ThreadPool::ThreadPool(const int threads, const size_t capacity,
+		       const bool pin/*=false*/):
+    submitted(capacity, threads < 1 ? availableCpus() : threads),
+    epoch(0), closed(false){
+    int num_threads = threads < 1 ? availableCpus() : threads, i, c;
+
+    //the cpus the workers are pinned to
+    std::vector<int> cpus;
+    cpu_set_t set;
+    if(pin && sched_getaffinity(0, sizeof set, &set) == 0){
+	for(c=0; c<CPU_SETSIZE; ++c){
+	    if(CPU_ISSET(c, &set)) cpus.push_back(c);
+	}
+    }
+
+    for(i=0; i<num_threads; ++i){
+	workers.emplace_back(new Worker());
+    }
+    minions.reserve(num_threads);
+    for(i=0; i<num_threads; ++i){
+	minions.emplace_back(&ThreadPool::atWork, this, i);
+	if(!cpus.empty()){
+	    CPU_ZERO(&set);
+	    CPU_SET(cpus[i % cpus.size()], &set);
+	    if(pthread_setaffinity_np(minions[i].native_handle(),
+				      sizeof set, &set) != 0){
+		fprintf(stderr, "Cannot pin thread %d to cpu %d\n",
+			i, cpus[i % cpus.size()]);
+	    }
+	}
+    }
+}
+
+ThreadPool::~ThreadPool(){
+    finish();
+}
+
+int ThreadPool::currentWorker(){
+    return worker_index;
+}
+
+void ThreadPool::wakeUp(){
+    {
+	std::lock_guard<std::mutex> lock(door);
+	++epoch;
+    }
+    trumpet.notify_all();
+}
+
+void ThreadPool::submit(Batch& b){
+    if(b.empty()) return;
+    submitted.push(b);
+    wakeUp();
+}
+
+void ThreadPool::finish(){
+    {
+	std::lock_guard<std::mutex> lock(door);
+	if(closed) return;
+	closed = true;
+    }
+    trumpet.notify_all();
+    for(auto& x : minions){
+	x.join();
+    }
+}
+
+bool ThreadPool::popLocal(const int x, Task& t){
+    Worker& w = *workers[x];
+    std::lock_guard<std::mutex> lock(w.door);
+    if(w.tasks.empty()) return false;
+    t = std::move(w.tasks.front());
+    w.tasks.pop_front();
+    return true;
+}
+
+bool ThreadPool::steal(const int x, Task& t){
+    int num_workers = workers.size(), i;
+    size_t half;
+    std::deque<Task> loot;
+
+    for(i=1; i<num_workers; ++i){
+	Worker& v = *workers[(x+i) % num_workers];
+	{//the newest half of the victim's tasks (at least one)
+	    std::lock_guard<std::mutex> lock(v.door);
+	    if(v.tasks.empty()) continue;
+	    half = (v.tasks.size() + 1) / 2;
+	    loot.assign(std::make_move_iterator(v.tasks.end() - half),
+			std::make_move_iterator(v.tasks.end()));
+	    v.tasks.erase(v.tasks.end() - half, v.tasks.end());
+	}
+	t = std::move(loot.front());
+	loot.pop_front();
+	if(!loot.empty()){
+	    Worker& w = *workers[x];
+	    std::lock_guard<std::mutex> lock(w.door);
+	    for(auto& y : loot){
+		w.tasks.push_back(std::move(y));
+	    }
+	}
+	return true;
+    }
+    return false;
+}
+
+void ThreadPool::atWork(const int x){
+    Worker& w = *workers[x];
+    Batch b;
+    Task t;
+    size_t seen;
+    bool last;
+
+    worker_index = x;
+    while(true){
+	{
+	    std::lock_guard<std::mutex> lock(door);
+	    seen = epoch;
+	    last = closed;
+	}
+	if(popLocal(x, t) || steal(x, t)){
+	    t();
+	    continue;
+	}
+	if(submitted.tryPop(b)){
+	    {
+		std::lock_guard<std::mutex> lock(w.door);
+		for(auto& y : b.jobs){
+		    w.tasks.push_back(std::move(y.first));
+		}
+	    }
+	    //the others may steal from it
+	    if(b.jobs.size() > 1) wakeUp();
+	    continue;
+	}
+	//no task anywhere when last is read: none will come
+	if(last) return;
+
+	std::unique_lock<std::mutex> lock(door);
+	while(epoch == seen && !closed){
+	    trumpet.wait(lock);
+	}
+    }
+}
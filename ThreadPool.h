@@ -0,0 +1,100 @@
+/*
+  A work-stealing pool of worker threads shared by the drivers.
+
+  Tasks are submitted in weighted batches to a BoundedQueue, so that a
+  producer waits while the pool holds its capacity. A worker runs the
+  tasks of its own deque first, then steals half of the deque of
+  another worker, and only then takes its share of the submitted
+  batches into its deque. With skewed task sizes (e.g., read lengths),
+  the workers done early thus take over the backlog of a busy one
+  instead of waiting.
+
+  The number of threads defaults to availableCpus(). With pinning,
+  worker i runs on the i-th cpu of the affinity mask of the process, so
+  that the memory it touches first (e.g., its dp tables) stays on its
+  NUMA node.
+
+  Last edited: 10/16/2026
+*/
+
+#ifndef _THREADPOOL_H
+#define _THREADPOOL_H 1
+
+#include <cstddef>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "BoundedQueue.hpp"
+
+/*
+  Number of cpus the process may use: the cpus of its affinity mask,
+  bounded by the cpu quota of its cgroup (v2 cpu.max or v1
+  cpu.cfs_quota_us) rounded up. At least 1.
+*/
+int availableCpus();
+
+class ThreadPool{
+public:
+    typedef std::function<void()> Task;
+    typedef BoundedQueue<Task>::Batch Batch;
+
+private:
+    struct Worker{
+	std::mutex door;
+	std::deque<Task> tasks;
+    };
+
+    BoundedQueue<Task> submitted;
+    std::vector<std::unique_ptr<Worker> > workers;
+    std::vector<std::thread> minions;
+    //idle workers wait for a new batch (epoch changes) or the end
+    size_t epoch;
+    bool closed;
+    std::mutex door;
+    std::condition_variable trumpet;
+
+    void atWork(const int x);
+    bool popLocal(const int x, Task& t);
+    bool steal(const int x, Task& t);
+    void wakeUp();
+
+public:
+    /*
+      Start the workers.
+      --threads is the number of workers, availableCpus() if < 1;
+      --capacity is the largest total weight of the queued batches;
+      --pin pins worker i to the i-th available cpu.
+    */
+    ThreadPool(const int threads, const size_t capacity,
+	       const bool pin=false);
+    //finish (see below)
+    ~ThreadPool();
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator = (const ThreadPool&) = delete;
+
+    int size() const { return workers.size(); };
+
+    /*
+      The index (in [0, size())) of the worker running the caller, -1 if
+      it is not a worker of a pool. A task may thus keep per worker state
+      (e.g., dp tables) without locking.
+    */
+    static int currentWorker();
+
+    /*
+      Queue the tasks of b (b is cleared), wait while the pool is full.
+    */
+    void submit(Batch& b);
+
+    /*
+      Run all the submitted tasks and stop the workers. No task can be
+      submitted afterwards.
+    */
+    void finish();
+};
+
+#endif // ThreadPool.h
@@ -13,6 +13,7 @@
 
 #include "util.h"
 #include "SeedGraph.hpp"
+#include "ReadFile.h"
 #include <sys/stat.h>
 #include <iostream>
 #include <fstream>
@@ -57,22 +58,13 @@ static inline Node* storeSeedWithPosInGraph(
     return cur;
 }
 
-static inline double getScoreFromDPTable(const int n, const int k,
-					 const DPCell* dp){
-    int q = access2d(k+1, n, k);
-    double score = fabs(dp[q].min);
-    if(score < dp[q].max) return dp[q].max;
-    else return score;
-}
 			      
 
-void addToGraph(const string &read, const size_t read_idx, const int n,
-		const int k, const RandTableCell *tp,
+void addToGraph(const char* read, const int len, const size_t read_idx,
+		const int n, const int k, const RandTableCell *tp,
 		const double threshold, Graph &g,
 	        ReadPath& path){
-    int len = read.length();
     int i;
-    char cur[n+1];
     kmer seed;
     double score = threshold;
     Node *prev = nullptr;
@@ -81,47 +73,46 @@ void addToGraph(const string &read, const size_t read_idx, const int n,
     //calculate an extra column, can skip next position if score at
     //[n+1][k] does not reach threshold; otherwise does not need recalculation
     //if backtrack from [n+1][k] does not use first char
-    DPCell dp[(n+2)*(k+1)];
+    DPTable dp(n+1, k);
+    FoldedRandTable ft(k, tp);
+    //most windows do not pass the threshold, they are filtered by the
+    //score-only pass and only the rest need the full dp table
+    double rows[(k+1)<<1];
 
     for(i=0; i<len-n; i+=1){
-	read.copy(cur, n+1, i);
-	fillDPTable(cur, n+1, k, tp, dp);
+	if(scoreDPTable(read+i, n+1, k, ft, rows, &score) < threshold){
+	    ++i; //neither pos i nor i+1 reaches the threshold
+	    continue;
+	}
+	fillDPTable(read+i, n+1, k, ft, dp);
 	//printf("called at %d\n", i);
 
 	//get seed from pos i
-	score = getScoreFromDPTable(n, k, dp);
 	if(score >= threshold){
-	    backtrackDPTable(cur, n, k, dp, &seed);
+	    backtrackDPTable(read+i, n, k, dp, &seed);
 	    //add to graph
 	    prev = storeSeedWithPosInGraph(seed, read_idx, i,
 					   &prev_pos, prev, g, path);
 	}
 
-	score = getScoreFromDPTable(n+1, k, dp);
-	if(score >= threshold){
-	    if(!backtrackDPTable(cur, n+1, k, dp, &seed)){//first char not used
-		++i; //skip recalculation of next position
-		//add to graph
-		prev = storeSeedWithPosInGraph(seed, read_idx, i,
-					       &prev_pos, prev, g, path);
-	    }
-	}else{//score less than threshold even with extra column, actual score can only be lower
-	    ++i;
+	//score at [n+1][k] passed the threshold
+	if(!backtrackDPTable(read+i, n+1, k, dp, &seed)){//first char not used
+	    ++i; //skip recalculation of next position
+	    //add to graph
+	    prev = storeSeedWithPosInGraph(seed, read_idx, i,
+					   &prev_pos, prev, g, path);
 	}
     }
 
     //handle last seed, either it's never calculated or the previous
     //iteration did not work (i.e., score >= threshold but used 1st char)
-    if(i == len - n){
-	read.copy(cur, n, i);
-	fillDPTable(cur, n, k, tp, dp);
+    if(i == len - n &&
+       scoreDPTable(read+i, n, k, ft, rows, NULL) >= threshold){
+	fillDPTable(read+i, n, k, ft, dp);
 	//printf("called at %d\n", i);
-	score = getScoreFromDPTable(n, k, dp);
-	if(score >= threshold){
-	    backtrackDPTable(cur, n, k, dp, &seed);
-	    prev = storeSeedWithPosInGraph(seed, read_idx, i,
-					   &prev_pos, prev, g, path);
-	}
+	backtrackDPTable(read+i, n, k, dp, &seed);
+	prev = storeSeedWithPosInGraph(seed, read_idx, i,
+				       &prev_pos, prev, g, path);
     }
 }
 
@@ -147,7 +138,8 @@ int main(int argc, const char * argv[])
 	saveRandTable(table_filename, k, table);
     }
 
-    ifstream fin(argv[1], ifstream::in);
+    ReadFile fin(argv[1]);
+    if(!fin.good()) return 1;
 
     char output_filename[200];
     int output_len = strstr(argv[1], ".efa") - argv[1];
@@ -163,19 +155,17 @@ int main(int argc, const char * argv[])
 			 table_filename+tablename_st,
 			 THRESHOLDFACTOR);
 
-    string read;
-    size_t read_idx = 0;
+    ReadParser parser(fin);
+    ReadRecord r;
+    size_t read_idx;
     Graph g;
     vector<ReadPath> paths;
     
-    while(fin.get() == '>'){
-	fin >> read_idx;
-	//skip the header
-	fin.ignore(numeric_limits<streamsize>::max(), '\n');
-	getline(fin, read);
-	//++ read_idx;
+    while(parser.next(r)){
+	//the read id is the number in the header
+	read_idx = r.headerNumber();
 	ReadPath p(read_idx);
-	addToGraph(read, read_idx, n, k, table, threshold, g, p);
+	addToGraph(r.seq, r.seq_len, read_idx, n, k, table, threshold, g, p);
 	paths.push_back(p);
     }
 
@@ -1,181 +1,568 @@
 /*
-  Given a fasta read file, for each read, generate subseq seeds and save them
+  Given a fasta (or fastq) read file, for each read, generate subseq seeds and save them
   in a file. The seeds are generated with parameters n, k, and a set of
   random tables. The given table is loaded if it exists, otherwise a new set
   of random tables is generated and saved with the provided name. (See the 
   manuscript for more info on the algorithm of generating subseq seeds).
 
   Only seeds with scores at least the threshold are kept.
+
+  Several table files can be given, the seeds of all of them are then
+  generated in a single pass over the reads and each table gets its own
+  output directory.
+
+  With the optional argument "int", the integer scoring mode is used
+  (see IntRandTable) and randTableFile is an integer table file, so that
+  the seeds are reproducible across machines and builds.
+
+  With the optional argument "rc", the seeds are canonical: each window is
+  seeded together with its reverse complement and the seed of the better
+  strand is kept along with a strand bit (see
+  getSubseqSeedsThresholdBatchCanonical). Not available in the integer
+  mode.
+
+  With the optional argument "mask", windows containing a base other than
+  ACGT (either case, e.g., N) are skipped without any dp work and the
+  number of skipped windows is reported (see getValidSegments).
+
+  With the optional argument "mod=P", the modular variant with P buckets
+  is used (see ModRandTable) and randTableFile is a modular table file.
+  Not available in the integer or rc modes.
   
-  The seeds are generated in parallel with NUMTHREADS threads.
+  With the optional argument "threads=T", the seeds are generated by T
+  threads, by default as many as the available cpus (see availableCpus).
+  With the optional argument "pin", each thread is pinned to a cpu.
+
+  The seeds are generated in parallel by a ThreadPool. Reads with
+  more than CHUNKWINDOWS windows are split into chunks of CHUNKWINDOWS
+  windows (consecutive chunks overlap by n-1 chars) that are seeded by
+  different threads, the seeds of the chunks are then stitched so that
+  the result is the same as seeding the whole read. Queued reads are kept
+  at 2 bits per base (see PackedRead) and the default, threshold and mask
+  paths seed a chunk from the packed bases in place; only the integer,
+  rc and mod modes unpack it to a string. The chunks are queued in batches
+  of about QUEUEBATCHBASES bases in a pool of at most QUEUEBASES bases,
+  the parsers wait while it is full.
 
-  Seeds for each read is stored in a separate file. The files are meant to be
-  loaded to generate a seed graph where nodes are seeds and two seeds are
-  connected if they are obtained from consecutive windows (ignoring windows
-  where no seed pass the threshold) on some read.
+  The read file is mapped in memory and parsed by NUMPARSERS threads,
+  each on its own byte range of the file (see ReadFile.h). Reads are
+  numbered in the order of the file. A gzip-compressed file (e.g.,
+  .fa.gz or .fq.gz) is streamed instead: it is decompressed by
+  NUMDECOMPRESSORS threads (in parallel only if it is BGZF) while the
+  reads are parsed and queued.
+
+  For k > 64, the seeds are stored as longkmer (see LongKmer.hpp) and k can
+  be up to LONGKMERMAXK.
+
+  The seeds of all reads are stored in a single file of the output
+  directory (see SeedStore.h), with n, k, the threshold and the id of the
+  table in its header. The seeds are delta/varint encoded, with the
+  optional argument "deflate" the seeds of each read are deflated as
+  well. The seeding threads only encode the seeds, the store is written
+  by a thread of its own; the largest backlog of that thread is
+  reported.
+
+  The stores are checkpointed periodically (see SeedStoreWriter). With
+  the optional argument "resume", an interrupted run is resumed from the
+  checkpoints: the parsing starts right after the smallest watermark of
+  the tables in the read file, without parsing the reads before it, and
+  the reads the checkpoints of all tables have are not seeded again. A
+  gzip-compressed file cannot be resumed from an offset: it is
+  decompressed and parsed again from its start, only the reads before
+  the watermark are not seeded.
+
+  The seeds are meant to be loaded to generate a seed graph where nodes
+  are seeds and two seeds are connected if they are obtained from
+  consecutive windows (ignoring windows where no seed pass the
+  threshold) on some read.
 
   By: Ke@PSU
   Last edited: 03/10/2023
 */
 
 #include "util.h"
+#include "simdDP.h"
+#include "SubseqSeeder.hpp"
+#include "ReadFile.h"
+#include "ThreadPool.h"
+#include "SeedStore.h"
 #include <sys/stat.h>
-#include <iostream>
-#include <fstream>
 #include <thread>
 #include <mutex>
-#include <queue>
-#include <condition_variable>
 #include <functional>
+#include <memory>
+#include <atomic>
 
 using namespace std;
 
-#define NUMTHREADS 15
+#define NUMPARSERS 4
+#define NUMDECOMPRESSORS 4
 #define EXPECTEDVALUE ((1lu<<30)+(1lu<<29))
 #define THRESHOLDFACTOR 0.0//0.785
+#define CHUNKWINDOWS 20000
+#define QUEUEBASES (1lu<<26)
+#define QUEUEBATCHBASES (1lu<<20)
 
 
+//reads are queued packed (see PackedRead)
+template<class T>
 struct Read{
-    string seq;
+    PackedRead seq;
     size_t idx;
+    size_t input_end; //see ReadRecord
+    //seeds of each chunk with each table, and the number of chunks
+    //not yet seeded
+    vector<vector<vector<SeedT<T> > > > chunk_seeds;
+    atomic<size_t> remaining;
 
-    Read(string&& s, size_t i): seq(move(s)), idx(i) {};
-    Read(Read&& o): seq(move(o.seq)), idx(exchange(o.idx, 0)) {};
+    Read(const char* s, size_t len, size_t i, size_t e, size_t num_chunks,
+	 size_t num_tables):
+	seq(s, len), idx(i), input_end(e),
+	chunk_seeds(num_chunks, vector<vector<SeedT<T> > >(num_tables)),
+	remaining(num_chunks) {};
 };
 
+template<class T>
+struct Chunk{
+    shared_ptr<Read<T> > read;
+    size_t id; //windows [id*CHUNKWINDOWS, (id+1)*CHUNKWINDOWS)
+
+    Chunk(const shared_ptr<Read<T> >& r, size_t id): read(r), id(id) {};
+};
+
+/*
+  A set of random tables and the store of its seeds (in output_dir).
+*/
+struct SeedTable{
+    vector<RandTableCell> table;
+    IntRandTable int_table;
+    ModRandTable mod_table;
+    vector<double> bound;
+    string output_dir;
+    shared_ptr<SeedStoreWriter> store;
+
+    SeedTable(const int k):
+	table(k*ALPHABETSIZE), int_table(k), bound(k+1) {};
+};
+
+template<class T>
 class SeedFactory{
     const int n;
     const int k;
-    const RandTableCell* table;
+    const vector<SeedTable>& tables;
+    vector<const RandTableCell*> tps;
+    const bool int_mode;
+    const bool canonical;
+    const bool mask;
+    const bool mod_mode;
     const double threshold;
-    const char* output_dir;
-    const int dir_len;
-    
-    queue<Read> jobs;
-    vector<thread> minions;
-    bool done;
-    mutex door;
-    condition_variable trumpet;
-    
-    void getAndSaveSubseqSeeds(const Read &r){
-	vector<Seed> seeds_list;
-	getSubseqSeedsThreshold(r.seq, n, k, table, threshold, seeds_list);
+    SeedingStats& stats;
+    //the seeders (specialized for (n, k) if available) of each worker,
+    //one per table, built by the worker on its first chunk
+    vector<vector<unique_ptr<SubseqSeedsKernel<T> > > > seeders;
 
-	char output_filename[200];
-	sprintf(output_filename, "%.*s/%zu.subseqseed",
-		dir_len, output_dir, r.idx);
+public:
+    typedef ThreadPool::Batch JobBatch;
 
-	saveSubseqSeeds(output_filename, seeds_list);
-    }
+private:
+    mutex door; //for stats
+    ThreadPool minions;
     
-    void atWork(int x){
-	unique_lock<mutex> lock(door, defer_lock);
-	while(true){
-	    lock.lock();
-	    while(!done && jobs.empty()){
-		trumpet.wait(lock);
+    /*
+      Seeds of the len chars of seq from st with each table, with the path
+      of the current mode, the positions are relative to st.
+    */
+    void getSubseqSeeds(const PackedRead& seq, const size_t st,
+			const size_t len,
+			vector<vector<SeedT<T> > >& seeds_lists,
+			SeedingStats& local){
+	size_t num_tables = tables.size(), t;
+	if(int_mode || canonical || mod_mode){
+	    //these paths take the chars
+	    getSubseqSeeds(seq.unpack(st, len), seeds_lists);
+	}else if(threshold > 0){
+	    //most windows are rejected, filter them by the (pruned)
+	    //score-only pass before filling the full dp tables
+	    vector<unique_ptr<SubseqSeedsKernel<T> > >& mine =
+		seeders[ThreadPool::currentWorker()];
+	    if(mine.empty()){
+		for(t=0; t<num_tables; ++t){
+		    mine.push_back(makeSubseqSeeder<T>(n, k, tps[t],
+						       tables[t].bound.data()));
+		}
 	    }
-	    if(!jobs.empty()){
-		Read r = move(jobs.front());
-		jobs.pop();
-		lock.unlock();
-		getAndSaveSubseqSeeds(r);
-	    }else{
-		return;
+	    for(t=0; t<num_tables; ++t){
+		mine[t]->getSeeds(PackedSeq(seq, st), len, threshold,
+				  seeds_lists[t], &local);
 	    }
+	}else{
+	    //all the tables in one pass over the read
+	    getSubseqSeedsThresholdBatchMulti(PackedSeq(seq, st), len, n, k,
+					      num_tables, tps.data(),
+					      threshold, seeds_lists.data());
 	}
     }
 
+    //the integer, canonical or modular seeds of seq with each table
+    void getSubseqSeeds(const string& seq,
+			vector<vector<SeedT<T> > >& seeds_lists){
+	size_t num_tables = tables.size(), t;
+	if(int_mode){
+	    for(t=0; t<num_tables; ++t){
+		getSubseqSeedsThresholdBatchInt(seq, n, k,
+						tables[t].int_table,
+						threshold, seeds_lists[t]);
+	    }
+	}else if(canonical){
+	    for(t=0; t<num_tables; ++t){
+		getSubseqSeedsThresholdBatchCanonical(seq, n, k, tps[t],
+						      threshold,
+						      seeds_lists[t]);
+	    }
+	}else{
+	    for(t=0; t<num_tables; ++t){
+		getSubseqSeedsModThreshold(seq, n, k, tables[t].mod_table,
+					   threshold, seeds_lists[t]);
+	    }
+	}
+    }
+
+    void getAndSaveSubseqSeeds(const Chunk<T> &c){
+	Read<T>& r = *c.read;
+	size_t num_tables = tables.size(), t, i;
+	size_t num_chunks = r.chunk_seeds.size();
+	vector<vector<SeedT<T> > >& seeds_lists = r.chunk_seeds[c.id];
+	//the chars of the windows of this chunk
+	const size_t st = c.id*CHUNKWINDOWS;
+	const size_t len = min((size_t)CHUNKWINDOWS+n-1, r.seq.len-st);
+	SeedingStats local;
+
+	if(mask){//seed each segment without invalid bases
+	    vector<pair<size_t, size_t> > segments;
+	    vector<vector<SeedT<T> > > segment_lists(num_tables);
+	    getValidSegments(r.seq, st, len, n, segments, &local);
+	    for(const auto& sg : segments){
+		for(t=0; t<num_tables; ++t) segment_lists[t].clear();
+		getSubseqSeeds(r.seq, st+sg.first, sg.second-sg.first,
+			       segment_lists, local);
+		for(t=0; t<num_tables; ++t){
+		    appendSeedsInVector(segment_lists[t], sg.first,
+					seeds_lists[t]);
+		}
+	    }
+	}else{
+	    getSubseqSeeds(r.seq, st, len, seeds_lists, local);
+	}
+	{
+	    lock_guard<mutex> lock(door);
+	    stats += local;
+	}
+
+	if(r.remaining.fetch_sub(1) > 1) return;
+
+	//the last chunk of the read is done
+	for(t=0; t<num_tables; ++t){
+	    vector<SeedT<T> >& seeds_list = r.chunk_seeds[0][t];
+	    for(i=1; i<num_chunks; ++i){
+		appendSeedsInVector(r.chunk_seeds[i][t], i*CHUNKWINDOWS,
+				    seeds_list);
+	    }
+	    tables[t].store->append(r.idx, seeds_list, r.input_end);
+	}
+    }
+    
 public:
-    SeedFactory(const int n, const int k, const RandTableCell* table,
-		const double threshold, const char* output_dir, const int dir_len):
-	n(n), k(k), table(table), threshold(threshold),
-	output_dir(output_dir), dir_len(dir_len), done(false){
-
-	minions.reserve(NUMTHREADS);
-	for(int i=0; i<NUMTHREADS; ++i){
-	    minions.emplace_back(bind(&SeedFactory::atWork, this, i));
+    SeedFactory(const int n, const int k, const vector<SeedTable>& tables,
+		const bool int_mode, const bool canonical, const bool mask,
+		const bool mod_mode, const double threshold,
+		SeedingStats& stats, const int num_threads, const bool pin):
+	n(n), k(k), tables(tables), int_mode(int_mode), canonical(canonical),
+	mask(mask), mod_mode(mod_mode), threshold(threshold),
+	stats(stats), minions(num_threads, QUEUEBASES, pin){
+	seeders.resize(minions.size());
+
+	for(const SeedTable& st : tables){
+	    tps.push_back(st.table.data());
 	}
     }
 
     ~SeedFactory(){
-	unique_lock<mutex> lock(door);
-	done = true;
-	lock.unlock();
-	trumpet.notify_all();
+	minions.finish();
+    }
 
-	for(auto& x : minions){
-	    x.join();
+    //whether the checkpoints of all tables have the read
+    bool resumed(size_t idx) const{
+	for(const SeedTable& st : tables){
+	    if(!st.store->hasRead(idx)) return false;
 	}
+	return true;
     }
 
-    void addJob(string&& r, size_t idx){
-	unique_lock<mutex> lock(door);
-	jobs.emplace(move(r), idx);
-	trumpet.notify_one();
+    /*
+      Add the chunks of a read to the batch of the caller, the batch is
+      queued once it has QUEUEBATCHBASES bases (waiting while the queue
+      is full). The last batch is queued by flushJobs.
+    */
+    void addJob(const char* r, size_t len, size_t idx, size_t input_end,
+		JobBatch& batch){
+	if(resumed(idx)) return;
+	size_t num_windows = len < (size_t)n ? 0 : len-n+1;
+	size_t num_chunks = num_windows > CHUNKWINDOWS ?
+	    (num_windows + CHUNKWINDOWS - 1) / CHUNKWINDOWS : 1;
+	shared_ptr<Read<T> > read = make_shared<Read<T> >(r, len, idx,
+							  input_end,
+							  num_chunks,
+							  tables.size());
+	size_t i, st;
+	for(i=0; i<num_chunks; ++i){
+	    st = i*CHUNKWINDOWS;
+	    Chunk<T> c(read, i);
+	    batch.add([this, c]{ getAndSaveSubseqSeeds(c); },
+		      st >= len ? 0 : min(len-st, (size_t)CHUNKWINDOWS+n-1));
+	}
+	if(batch.weight >= QUEUEBATCHBASES) minions.submit(batch);
+    }
+
+    void flushJobs(JobBatch& batch){
+	minions.submit(batch);
     }
 };
 
+/*
+  Count the records of a byte range of the file.
+*/
+static void countRange(const ReadFile& fin, const pair<size_t, size_t> range,
+		       size_t* count){
+    *count = fin.countRecords(range.first, range.second);
+}
+
+/*
+  Queue the reads of a byte range of the file, the first one has the
+  given id.
+*/
+template<class T>
+static void parseRange(const ReadFile& fin, const pair<size_t, size_t> range,
+		       const size_t first_id, SeedFactory<T>* factory){
+    ReadParser parser(fin, range.first, range.second, first_id);
+    ReadRecord r;
+    typename SeedFactory<T>::JobBatch batch;
+    while(parser.next(r)){
+	factory->addJob(r.seq, r.seq_len, r.id, r.end, batch);
+    }
+    factory->flushJobs(batch);
+}
+
+/*
+  Seed the reads of the file after the first skip ones with the k-mer type
+  T, return false if the file cannot be read.
+  --from is the offset of the file right after read skip, the file is
+    parsed from its start if no record starts there (the reads of the
+    checkpoints are still not seeded again). A gzip-compressed file has
+    no such offset (its records are not located in the file), it is
+    decompressed and parsed from its start, skipping the first skip
+    reads.
+*/
+template<class T>
+static bool seedReads(const char* filename, const int n, const int k,
+		      const vector<SeedTable>& tables,
+		      const bool int_mode, const bool canonical,
+		      const bool mask, const bool mod_mode,
+		      const double threshold, SeedingStats& stats,
+		      const int num_threads, const bool pin,
+		      size_t skip, size_t from){
+    SeedFactory<T> factory(n, k, tables, int_mode, canonical, mask,
+			   mod_mode, threshold, stats, num_threads, pin);
+
+    if(isGzipFile(filename)){
+	ReadStream fin(filename, NUMDECOMPRESSORS);
+	ReadRecord r;
+	typename SeedFactory<T>::JobBatch batch;
+	while(fin.next(r)){
+	    if(r.id > skip) factory.addJob(r.seq, r.seq_len, r.id, 0, batch);
+	}
+	factory.flushJobs(batch);
+	return fin.good();
+    }
+
+    ReadFile fin(filename);
+    if(!fin.good()) return false;
+    //the checkpoints have checked the bytes around from are the same
+    if(skip > 0 && (from == 0 || !fin.isRecordStart(from))){
+	fprintf(stderr, "Offset %zu is not right after read %zu,"
+		" parsing from the start\n", from, skip);
+	skip = from = 0;
+    }
+    vector<pair<size_t, size_t> > ranges = fin.split(NUMPARSERS, from);
+    size_t num_ranges = ranges.size(), i;
+    vector<size_t> first_id(num_ranges+1, 0);
+    vector<thread> parsers;
+
+    //the id of the first read of each range is one plus the number of
+    //reads before it
+    for(i=0; i<num_ranges; ++i){
+	parsers.emplace_back(countRange, cref(fin), ranges[i], &first_id[i+1]);
+    }
+    for(auto& x : parsers) x.join();
+    parsers.clear();
+    first_id[0] = skip + 1;
+    for(i=1; i<num_ranges; ++i) first_id[i] += first_id[i-1];
+
+    for(i=0; i<num_ranges; ++i){
+	parsers.emplace_back(parseRange<T>, cref(fin), ranges[i], first_id[i],
+			     &factory);
+    }
+    for(auto& x : parsers) x.join();
+    return true;
+}
+
 int main(int argc, const char * argv[])
 {
-    if(argc != 5){
-	printf("usage: genSubseqSeeds.out readFile n k randTableFile\n");
+    bool int_mode = false, canonical = false, mask = false, pin = false;
+    bool deflate = false, resume = false;
+    int p = 0; //number of buckets of the modular variant, 0 if not used
+    int num_threads = 0; //availableCpus() if not given
+    int num_tables = argc - 4;
+    for(; num_tables > 1; --num_tables){//trailing options
+	if(strcmp(argv[3+num_tables], "int") == 0) int_mode = true;
+	else if(strcmp(argv[3+num_tables], "rc") == 0) canonical = true;
+	else if(strcmp(argv[3+num_tables], "mask") == 0) mask = true;
+	else if(strcmp(argv[3+num_tables], "pin") == 0) pin = true;
+	else if(strcmp(argv[3+num_tables], "deflate") == 0) deflate = true;
+	else if(strcmp(argv[3+num_tables], "resume") == 0) resume = true;
+	else if(strncmp(argv[3+num_tables], "threads=", 8) == 0){
+	    num_threads = atoi(argv[3+num_tables]+8);
+	    if(num_threads < 1){
+		printf("threads=T needs T >= 1\n");
+		return 1;
+	    }
+	}
+	else if(strncmp(argv[3+num_tables], "mod=", 4) == 0){
+	    p = atoi(argv[3+num_tables]+4);
+	    if(p < ALPHABETSIZE){
+		printf("mod=P needs P >= %d\n", ALPHABETSIZE);
+		return 1;
+	    }
+	}else break;
+    }
+    bool mod_mode = p > 0;
+    if(num_tables < 1 || int_mode + canonical + mod_mode > 1){
+	printf("usage: genSubseqSeeds.out readFile n k randTableFile [randTableFile ...] [int|rc|mod=P] [mask] [deflate] [threads=T] [pin] [resume]\n");
 	return 1;
     }
 
     int n = atoi(argv[2]);
     int k = atoi(argv[3]);
+    if(k > LONGKMERMAXK){
+	printf("k must be at most %d\n", LONGKMERMAXK);
+	return 1;
+    }
     double threshold = THRESHOLDFACTOR * EXPECTEDVALUE * k;
 
-    //load table
-    RandTableCell table[k*ALPHABETSIZE];
-    const char* table_filename = argv[4];
-
-    struct stat test_table;
-    if(stat(table_filename, &test_table) == 0){//file exists
-	loadRandTable(table_filename, k, table);
-    }else{
-	initRandTable(k, table);
-	saveRandTable(table_filename, k, table);
+    vector<SeedTable> tables(num_tables, SeedTable(k));
+    char output_dir[200], mod_suffix[20] = "";
+    int dir_len = readFileStemLength(argv[1]);
+    struct stat test_table, input;
+    if(stat(argv[1], &input) != 0){
+	printf("Cannot find %s\n", argv[1]);
+	return 1;
     }
+    //resume from the smallest watermark
+    size_t skip = (size_t)-1, from = 0;
 
+    for(int t=0; t<num_tables; ++t){
+	//load table
+	SeedTable& st = tables[t];
+	RandTableCell* table = st.table.data();
+	const char* table_filename = argv[4+t];
 
-    //output directory
-    char output_dir[200];
-    int dir_len = strstr(argv[1], ".efa") - argv[1];
-    int tablename_st = strlen(table_filename) - 1;
-    for(; tablename_st>=0; --tablename_st){
-	if(table_filename[tablename_st] == '/'){
-	    break;
+	if(int_mode){
+	    if(stat(table_filename, &test_table) == 0){
+		if(!loadIntRandTable(table_filename, k, st.int_table)) return 1;
+	    }else{
+		initRandTable(k, table);
+		quantizeRandTable(k, table, st.int_table);
+		saveIntRandTable(table_filename, st.int_table);
+	    }
+	}else if(mod_mode){
+	    if(stat(table_filename, &test_table) == 0){
+		if(!loadModRandTable(table_filename, k, p, st.mod_table)){
+		    return 1;
+		}
+	    }else{
+		initModRandTable(k, p, st.mod_table);
+		saveModRandTable(table_filename, st.mod_table);
+	    }
+	}else if(stat(table_filename, &test_table) == 0){//file exists
+	    loadRandTable(table_filename, k, table);
+	}else{
+	    initRandTable(k, table);
+	    saveRandTable(table_filename, k, table);
 	}
-    }
-    ++tablename_st;
-    dir_len = sprintf(output_dir, "%.*s-seeds-%s-n%d-k%d-t%f",
-		      dir_len, argv[1],
-		      table_filename+tablename_st, n, k,
-		      THRESHOLDFACTOR);
+	if(!int_mode && !mod_mode) initSuffixBounds(k, table, st.bound.data());
 
-    mkdir(output_dir, 0744);
+	//output directory
+	int tablename_st = strlen(table_filename) - 1;
+	for(; tablename_st>=0; --tablename_st){
+	    if(table_filename[tablename_st] == '/'){
+		break;
+	    }
+	}
+	++tablename_st;
+	if(mod_mode) sprintf(mod_suffix, "-p%d", p);
+	sprintf(output_dir, "%.*s-seeds-%s-n%d-k%d-t%f%s%s%s",
+		dir_len, argv[1],
+		table_filename+tablename_st, n, k,
+		THRESHOLDFACTOR, canonical ? "-rc" : "", mod_suffix,
+		mask ? "-mask" : "");
+
+	mkdir(output_dir, 0744);
+	st.output_dir = output_dir;
+	st.store = make_shared<SeedStoreWriter>(
+	    (st.output_dir + "/" SEEDSTOREFILE).c_str(), n, k,
+	    k > 64 ? sizeof(LongSeed) : sizeof(Seed),
+	    fileId(table_filename), threshold, deflate, argv[1], resume);
+	if(!st.store->good()) return 1;
+	if(st.store->resumedReads() < skip){
+	    skip = st.store->resumedReads();
+	    from = st.store->resumedInputOffset();
+	}
+    }
+    if(skip > 0) printf("resuming after read %zu\n", skip);
 
     //input reads and process
-    ifstream fin(argv[1], ifstream::in);
+    SeedingStats stats;
+    bool read_ok;
 
-    {
-	SeedFactory factory(n, k, table, threshold, output_dir, dir_len);   
-	string read;
-	size_t read_idx = 0;
-    
-	while(fin.get() == '>'){
-	    //fin >> read_idx;
-	    //skip the header
-	    fin.ignore(numeric_limits<streamsize>::max(), '\n');
-	    getline(fin, read);
-	    ++ read_idx;
-	    factory.addJob(move(read), read_idx);
-	}
+    if(k > 64){
+	read_ok = seedReads<longkmer>(argv[1], n, k, tables, int_mode,
+				      canonical, mask, mod_mode, threshold,
+				      stats, num_threads, pin, skip, from);
+    }else{
+	read_ok = seedReads<kmer>(argv[1], n, k, tables, int_mode,
+				  canonical, mask, mod_mode, threshold,
+				  stats, num_threads, pin, skip, from);
+    }
+    if(!read_ok) return 1;
+    size_t queued_blocks, queued_bytes;
+    for(SeedTable& st : tables){
+	if(!st.store->close()) return 1;
+	st.store->queueDepth(queued_blocks, queued_bytes);
+	printf("writer queue of %s peaked at %zu reads (%zu bytes)\n",
+	       st.output_dir.c_str(), queued_blocks, queued_bytes);
     }
 
-    printf("%s %s %d %d %f %s done\n", argv[0], argv[1], n, k, threshold, argv[4]);
+    if(threshold > 0 && !int_mode && !canonical && !mod_mode){
+	printf("pruned %zu of %zu windows (%.2f%%)\n", stats.pruned,
+	       stats.windows, stats.windows ? 100.0*stats.pruned/stats.windows : 0);
+    }
+    if(mask){
+	printf("skipped %zu windows with invalid bases\n", stats.skipped);
+    }
+    printf("%s %s %d %d %f", argv[0], argv[1], n, k, threshold);
+    for(int t=0; t<num_tables; ++t){
+	printf(" %s", argv[4+t]);
+    }
+    printf(" done\n");
     
     return 0;
 }
@@ -16,18 +16,17 @@
 
 #include "util.h"
 #include "SeedsGraph.hpp"
+#include "ReadFile.h"
+#include "ThreadPool.h"
 #include <sys/stat.h>
 #include <iostream>
 #include <fstream>
-#include <thread>
-#include <mutex>
-#include <queue>
-#include <condition_variable>
-#include <functional>
+#include <memory>
 
 using namespace std;
 
-#define NUMTHREADS 15
+#define QUEUEBASES (1lu<<26)
+#define QUEUEBATCHBASES (1lu<<20)
 #define EXPECTEDVALUE ((1lu<<30)+(1lu<<29))
 #define THRESHOLDFACTOR 0.785
 
@@ -67,48 +66,31 @@ class SeedFactory{
     const double threshold;
     Graph &graph;
     
-    queue<Read> jobs;
-    vector<thread> minions;
-    bool done;
-    mutex door;
-    condition_variable trumpet;
+    ThreadPool minions; //as many threads as the available cpus
+    ThreadPool::Batch batch;
 
     Node* storeSeedWithPosInGraph(const kmer seed, const size_t read_idx,
 				  const size_t cur_pos, size_t* prev_pos,
 				  Node* prev, Graph& g);
 
-    double getScoreFromDPTable(const int n, const int k, const DPCell* dp);
-    
     void getAndSaveSubseqSeeds(const Read &r);
-    void atWork(int x);
 
 public:
     SeedFactory(const int n, const int k, const RandTableCell* table,
 		const double threshold, Graph& g):
 	n(n), k(k), table(table), threshold(threshold),
-	graph(g), done(false){
-
-	minions.reserve(NUMTHREADS);
-	for(int i=0; i<NUMTHREADS; ++i){
-	    minions.emplace_back(bind(&SeedFactory::atWork, this, i));
-	}
-    }
+	graph(g), minions(0, QUEUEBASES) {}
 
     ~SeedFactory(){
-	unique_lock<mutex> lock(door);
-	done = true;
-	lock.unlock();
-	trumpet.notify_all();
-
-	for(auto& x : minions){
-	    x.join();
-	}
+	minions.submit(batch);
+	minions.finish();
     }
 
     void addJob(string&& r, size_t idx){
-	unique_lock<mutex> lock(door);
-	jobs.emplace(move(r), idx);
-	trumpet.notify_one();
+	size_t len = r.length();
+	shared_ptr<Read> read = make_shared<Read>(move(r), idx);
+	batch.add([this, read]{ getAndSaveSubseqSeeds(*read); }, len);
+	if(batch.weight >= QUEUEBATCHBASES) minions.submit(batch);
     }
 };
 
@@ -136,22 +118,18 @@ int main(int argc, const char * argv[])
     }
 
     //input reads and process
-    ifstream fin(argv[1], ifstream::in);
+    ReadFile fin(argv[1]);
+    if(!fin.good()) return 1;
 
     Graph g;
     //vector<ReadPath> paths;
     SeedFactory factory(n, k, table, threshold, g);
     
-    string read;
-    size_t read_idx = 0;
+    ReadParser parser(fin);
+    ReadRecord r;
     
-    while(fin.get() == '>'){
-	//fin >> read_idx;
-	//skip the header
-	fin.ignore(numeric_limits<streamsize>::max(), '\n');
-	getline(fin, read);
-	++ read_idx;
-	factory.addJob(move(read), read_idx);
+    while(parser.next(r)){
+	factory.addJob(string(r.seq, r.seq_len), r.id);
     }
 
     //only keep reads that appear on multiple distinct reads
@@ -196,32 +174,6 @@ inline Node* SeedFactory::storeSeedWithPosInGraph(
     return cur;
 }
 
-inline double SeedFactory::getScoreFromDPTable(const int n, const int k,
-					       const DPCell* dp){
-    int q = access2d(k+1, n, k);
-    double score = fabs(dp[q].min);
-    if(score < dp[q].max) return dp[q].max;
-    else return score;
-}
-
-void SeedFactory::atWork(int x){
-    unique_lock<mutex> lock(door, defer_lock);
-    while(true){
-	lock.lock();
-	while(!done && jobs.empty()){
-	    trumpet.wait(lock);
-	}
-	if(!jobs.empty()){
-	    Read r = move(jobs.front());
-	    jobs.pop();
-	    lock.unlock();
-	    getAndSaveSubseqSeeds(r);
-	}else{
-	    return;
-	}
-    }
-}
-
 void SeedFactory::getAndSaveSubseqSeeds(const Read &r){
     int len = r.seq.length();
     
@@ -235,15 +187,23 @@ void SeedFactory::getAndSaveSubseqSeeds(const Read &r){
     //calculate an extra column, can skip next position if score at
     //[n+1][k] does not reach threshold; otherwise does not need recalculation
     //if backtrack from [n+1][k] does not use first char
-    DPCell dp[(n+2)*(k+1)];
+    DPTable dp(n+1, k);
+    FoldedRandTable ft(k, table);
+    //most windows do not pass the threshold, they are filtered by the
+    //score-only pass and only the rest need the full dp table
+    double rows[(k+1)<<1];
 	
     for(i=0; i<len-n; i+=1){
+	if(scoreDPTable(r.seq.c_str()+i, n+1, k, ft, rows, &score)
+	   < threshold){
+	    ++i; //neither pos i nor i+1 reaches the threshold
+	    continue;
+	}
 	r.seq.copy(cur, n+1, i);
-	fillDPTable(cur, n+1, k, table, dp);
+	fillDPTable(cur, n+1, k, ft, dp);
 	//printf("called at %d\n", i);
 
 	//get seed from pos i
-	score = getScoreFromDPTable(n, k, dp);
 	if(score >= threshold){
 	    backtrackDPTable(cur, n, k, dp, &seed);
 	    //add to graph
@@ -251,30 +211,24 @@ void SeedFactory::getAndSaveSubseqSeeds(const Read &r){
 					   &prev_pos, prev, graph);
 	}
 
-	score = getScoreFromDPTable(n+1, k, dp);
-	if(score >= threshold){
-	    if(!backtrackDPTable(cur, n+1, k, dp, &seed)){//first char not used
-		++i; //skip recalculation of next position
-		//add to graph
-		prev = storeSeedWithPosInGraph(seed, r.idx, i,
-					       &prev_pos, prev, graph);
-	    }
-	}else{//score less than threshold even with extra column, actual score can only be lower
-	    ++i;
+	//score at [n+1][k] passed the threshold
+	if(!backtrackDPTable(cur, n+1, k, dp, &seed)){//first char not used
+	    ++i; //skip recalculation of next position
+	    //add to graph
+	    prev = storeSeedWithPosInGraph(seed, r.idx, i,
+					   &prev_pos, prev, graph);
 	}
     }
 
     //handle last seed, either it's never calculated or the previous
     //iteration did not work (i.e., score >= threshold but used 1st char)
-    if(i == len - n){
+    if(i == len - n &&
+       scoreDPTable(r.seq.c_str()+i, n, k, ft, rows, NULL) >= threshold){
 	r.seq.copy(cur, n, i);
-	fillDPTable(cur, n, k, table, dp);
+	fillDPTable(cur, n, k, ft, dp);
 	//printf("called at %d\n", i);
-	score = getScoreFromDPTable(n, k, dp);
-	if(score >= threshold){
-	    backtrackDPTable(cur, n, k, dp, &seed);
-	    prev = storeSeedWithPosInGraph(seed, r.idx, i,
-					   &prev_pos, prev, graph);
-	}
+	backtrackDPTable(cur, n, k, dp, &seed);
+	prev = storeSeedWithPosInGraph(seed, r.idx, i,
+				       &prev_pos, prev, graph);
     }
 }
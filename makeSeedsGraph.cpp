@@ -1,5 +1,6 @@
 /*
-  Load a set of seed files, one for each read, as vertices of the graph.
+  Load the seeds of a seed directory (see SeedStore.h) as vertices of the
+  graph.
   Two seeds a and b are connected by a directed edge if they are adjacent
   seeds (in this order) on some read.
 
@@ -16,24 +17,25 @@
 
 #include "util.h"
 #include "SeedsGraph.hpp"
-#include <sys/stat.h>
+#include "SeedStore.h"
 #include <iostream>
 #include <fstream>
 
 using namespace std;
 
-typedef SeedsGraph<kmer> Graph;
-typedef Graph::Node Node;
-
-string kmerToString(const kmer& x, unsigned int k, char* buf){
+//T is kmer, or longkmer for k > 64 (see util.h)
+template<class T>
+string kmerToString(const T& x, unsigned int k, char* buf){
     decode(x, k, buf);
     return string(buf);
 }
 
-inline Node* storeSeedWithPosInGraph(
-    kmer seed, const size_t read_idx, const size_t cur_pos,
+template<class T>
+inline typename SeedsGraph<T>::Node* storeSeedWithPosInGraph(
+    T seed, const size_t read_idx, const size_t cur_pos,
     const size_t cur_span,
-    size_t* prev_pos, Node* prev, Graph& g){
+    size_t* prev_pos, typename SeedsGraph<T>::Node* prev, SeedsGraph<T>& g){
+    typedef typename SeedsGraph<T>::Node Node;
     //avoid self loops -- already done at seed generation
     //if(prev && prev->seed == seed) return prev;
     
@@ -47,64 +49,60 @@ inline Node* storeSeedWithPosInGraph(
     return cur;
 }
 
-void loadSubseqSeeds(const char* filename, const size_t read_idx, Graph& g){
-    FILE* fin = fopen(filename, "rb");
-    Seed s;
-    size_t prev_pos;
+template<class T>
+void loadSubseqSeeds(const SeedT<T>* seeds, const size_t count,
+		     const size_t read_idx, SeedsGraph<T>& g){
+    typedef typename SeedsGraph<T>::Node Node;
+    size_t prev_pos, i;
     Node* prev=nullptr;
     Node *head=nullptr, *tail=nullptr;
 
-    if(fread(&s, sizeof(s), 1, fin) == 1){
+    if(count > 0){
 	//first node
-	prev = g.addNode(s.v);
-	prev_pos = s.pos;
+	T first = seeds[0].v;
+	prev = g.addNode(first);
+	prev_pos = seeds[0].pos;
 	head = tail = prev;
 
 	//following nodes
-	while(fread(&s, sizeof(s), 1, fin) == 1){
-	    prev = storeSeedWithPosInGraph(s.v, read_idx, s.pos, s.span,
-					   &prev_pos, prev, g);
+	for(i=1; i<count; ++i){
+	    prev = storeSeedWithPosInGraph(seeds[i].v, read_idx, seeds[i].pos,
+					   seeds[i].span, &prev_pos, prev, g);
 	    tail = prev;
 	}
 
 	g.addReadPath(read_idx, head, tail);
     }
-    if(ferror(fin)){
-	fprintf(stderr, "Error reading %s/n", filename);
-    }
-    fclose(fin);
 }
 
-int main(int argc, const char * argv[])
-{
-    if(argc != 4){
-	printf("usage: makeSeedsGraph.out seedsDir k numFiles\n");
-	return 1;
-    }
-
-    unsigned int n = atoi(argv[3]);
-    unsigned int k = atoi(argv[2]);
-
+/*
+  Build the graph from the seeds of the k-mer type T and save it.
+*/
+template<class T>
+static int makeGraph(const char* dir, const unsigned int k,
+		     const unsigned int n){
     char filename[500];
-    unsigned int dir_len = strlen(argv[1]);
-    memcpy(filename, argv[1], dir_len);
+    unsigned int dir_len = strlen(dir);
+    memcpy(filename, dir, dir_len);
     if(filename[dir_len-1] != '/'){
 	filename[dir_len] = '/';
 	++dir_len;
     }
     
-    Graph g(n);
-    size_t j;
+    SeedsGraph<T> g(n);
+    size_t j, count;
+    const SeedT<T>* seeds;
 
     //load all seeds
-    struct stat test_file;
+    SeedStore store(dir);
+    if(!store.good()) return 1;
     for(j=1; j<=n; j+=1){
-	sprintf(filename+dir_len, "%zu.subseqseed", j);
-	if(stat(filename, &test_file) != 0){//seed file does not exist
-	    fprintf(stderr, "Stopped, cannot find file %zu.subseqseed\n", j);
+	seeds = store.getSeeds<T>(j, count);
+	if(seeds == NULL){//no seeds stored for the read
+	    fprintf(stderr, "Stopped, cannot find the seeds of read %zu\n", j);
 	    break;
 	}
-	loadSubseqSeeds(filename, j, g);
+	loadSubseqSeeds(seeds, count, j, g);
     }
 
     //only keep reads that appear on multiple distinct reads
@@ -114,7 +112,7 @@ int main(int argc, const char * argv[])
     sprintf(filename+dir_len, "overlap-n%d-graph.dot", n);
     char buf[k+1];
     buf[k] = '\0';
-    g.saveGraphToDot(filename, kmerToString, k, buf);
+    g.saveGraphToDot(filename, kmerToString<T>, k, buf);
 
     //save graph to binary file
     sprintf(filename+dir_len, "overlap-n%d.graph", n);
@@ -122,12 +120,26 @@ int main(int argc, const char * argv[])
 
     //test save and load graph produce an identical copy
     /*
-    Graph g2;
+    SeedsGraph<T> g2;
     g2.loadGraph(filename);
     sprintf(filename+dir_len, "overlap-n%d-graph.dot.cp", n);
-    g2.saveGraphToDot(filename, kmerToString, k, buf);
+    g2.saveGraphToDot(filename, kmerToString<T>, k, buf);
     */
     
     return 0;
 }
 
+
+int main(int argc, const char * argv[])
+{
+    if(argc != 4){
+	printf("usage: makeSeedsGraph.out seedsDir k numFiles\n");
+	return 1;
+    }
+
+    unsigned int n = atoi(argv[3]);
+    unsigned int k = atoi(argv[2]);
+
+    if(k > 64) return makeGraph<longkmer>(argv[1], k, n);
+    else return makeGraph<kmer>(argv[1], k, n);
+}
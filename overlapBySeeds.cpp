@@ -1,73 +1,136 @@
-/*
-  Given a set of seed files (readable by loadSubseqSeeds), output pairs of reads
-  with the number of unique seeds they share.
-  
-  By: Ke@PSU
-  Last edited: 10/01/2022
-*/
-
-#include "util.h"
-#include <sys/stat.h>
-#include <iostream>
-#include <fstream>
-
-using namespace std;
-
-int main(int argc, const char * argv[])    
-{   
-    if(argc != 3){
-	printf("usage: overlapBySeeds.out seedsDir numFiles\n");
-	return 1;
-    }
-
-    int n = atoi(argv[2]);
-    //int threshold = atoi(argv[3]);
-
-
-    char filename[500];
-    int i = strlen(argv[1]);
-    memcpy(filename, argv[1], i);
-    if(filename[i-1] != '/'){
-	filename[i] = '/';
-	++i;
-    }
-    
-    map<kmer, vector<int> > all_seeds;
-    int j;
-    
-    struct stat test_file;
-    for(j=1; j<=n; j+=1){
-	sprintf(filename+i, "%d.subseqseed", j);
-	if(stat(filename, &test_file) != 0){//seed file does not exist
-	    fprintf(stderr, "Stopped, cannot find file %d.subseqseed\n", j);
-	    break;
-	}
-	loadSubseqSeeds(filename, j, all_seeds);
-    }
-
-    sprintf(filename+i, "overlap-n%d.all-pair", n);
-
-    Table share_ct(n);
-
-    int a, b, c;
-    
-    for(auto& seed : all_seeds){
-	c = seed.second.size();
-	for(i=0; i<c; ++i){
-	    a = seed.second[i];
-	    for(j=i+1; j<c; ++j){
-		b = seed.second[j];
-		++ share_ct.access(a, b);
-		/*
-		if(share_ct.access(a, b) == threshold){
-		    fprintf(fout, "%d %d\n", a, b);
-		}
-		*/
-	    }
-	}
-    }
-
-    share_ct.saveNoneZeroEntries(filename);
-    
-    return 0;
-}
+/*
+  Given a seed directory (see SeedStore.h), output pairs of reads
+  with the number of unique seeds they share.
+  The k-mer type is read from the store, the optional k is only needed
+  for seeds in one file per read with k > 64 (stored as longkmer). No
+  output is written if the seeds cannot be loaded.
+  
+  By: Ke@PSU
+  Last edited: 10/01/2022
+*/
+
+#include "util.h"
+#include "SeedStore.h"
+#include "SeedIndex.h"
+#include "PairCounter.h"
+#include "ThreadPool.h"
+#include <iostream>
+#include <fstream>
+#include <thread>
+
+using namespace std;
+
+/*
+  Load the seeds of reads 1..n of the seed directory into an index, the
+  seeds are of the k-mer type T (see util.h). Each distinct seed has the
+  ids of the reads that contain it, in ascending order. Return false if
+  the store fails (e.g., the seeds are of another k-mer type).
+*/
+template<class T>
+static bool loadAllSeeds(SeedStore& store, const int n, SeedIndex<T>& index){
+    const SeedT<T>* seeds;
+    size_t count;
+    int j;
+    
+    for(j=1; j<=n; j+=1){
+	seeds = store.getSeeds<T>(j, count);
+	if(seeds == NULL){//no seeds stored for the read
+	    fprintf(stderr, "Stopped, cannot find the seeds of read %d\n", j);
+	    break;
+	}
+	index.add(seeds, count, j);
+    }
+    if(!store.good()) return false;
+    index.build(true);
+    return true;
+}
+
+/*
+  Count the seeds shared by each pair of reads 1..n. The seeds are split
+  among the threads, each with a counter of its own. Return false if
+  the seeds cannot be loaded.
+*/
+template<class T>
+static bool countSharedSeeds(SeedStore& store, const int n,
+			     PairCounter& share_ct){
+    SeedIndex<T> index;
+    if(!loadAllSeeds(store, n, index)) return false;
+
+    int num_threads = availableCpus(), t;
+    vector<PairCounter> counters(num_threads, PairCounter(n));
+
+    auto countSeeds = [&](const int t){
+	PairCounter& ct = counters[t];
+	const int* reads;
+	size_t s;
+	int a, b, c, i, j;
+
+	for(s=t; s<index.size(); s+=num_threads){
+	    reads = index.readIds(s);
+	    c = index.count(s);
+	    for(i=0; i<c; ++i){
+		a = reads[i];
+		for(j=i+1; j<c; ++j){
+		    b = reads[j];
+		    ct.add(a, b);
+		}
+	    }
+	}
+    };
+    vector<thread> minions;
+    for(t=1; t<num_threads; ++t){
+	minions.emplace_back(countSeeds, t);
+    }
+    countSeeds(0);
+    for(auto& x : minions){
+	x.join();
+    }
+
+    for(t=0; t<num_threads; ++t){
+	share_ct.merge(counters[t]);
+    }
+    return true;
+}
+
+int main(int argc, const char * argv[])    
+{   
+    if(argc != 3 && argc != 4){
+	printf("usage: overlapBySeeds.out seedsDir numFiles [k]\n");
+	return 1;
+    }
+
+    int n = atoi(argv[2]);
+    int k = argc == 4 ? atoi(argv[3]) : 0;
+    //int threshold = atoi(argv[3]);
+
+
+    char filename[500];
+    int i = strlen(argv[1]);
+    memcpy(filename, argv[1], i);
+    if(filename[i-1] != '/'){
+	filename[i] = '/';
+	++i;
+    }
+    
+    SeedStore store(argv[1]);
+    if(!store.good()) return 1;
+    if(store.isStore()){//the k-mer type is known from the store
+	if(k > 0 && k != store.k()){
+	    fprintf(stderr, "The seeds are stored with k=%d, not %d\n",
+		    store.k(), k);
+	    return 1;
+	}
+	k = store.k();
+    }
+
+    sprintf(filename+i, "overlap-n%d.all-pair", n);
+
+    PairCounter share_ct(n);
+    bool loaded = k > 64 ? countSharedSeeds<longkmer>(store, n, share_ct)
+	: countSharedSeeds<kmer>(store, n, share_ct);
+    if(!loaded) return 1;
+
+    share_ct.saveNoneZeroEntries(filename);
+    
+    return 0;
+}
@@ -1,119 +1,176 @@
-/*
-  Given a set of seed files (readable by loadSubseqSeedsPos), 
-  output pairs of reads with the number of unique seeds they share.
-  To avoid reporting transitive overlapping pairs, for each seed, 
-  reads containing it are sorted in reverse order according to the 
-  position of the seed. Only adjacent pairs in this order are counted. 
-  
-  By: Ke@PSU
-  Last edited: 04/07/2023
-*/
-
-#include "util.h"
-#include <sys/stat.h>
-#include <cstdlib>
-#include <iostream>
-#include <fstream>
-
-using namespace std;
-
-struct Occurrence{
-    int read_id;
-    unsigned int pos;
-
-    Occurrence(): read_id(0), pos(0){}
-    Occurrence(const int id, const unsigned int pos): read_id(id), pos(pos){}
-    Occurrence(const Occurrence& o): read_id(o.read_id), pos(o.pos){}
-    bool operator < (const Occurrence& x) const{
-	return pos > x.pos;
-    }
-};
-
-void loadSubseqSeedsPos(const char* filename, const int read_id,
-			map<kmer, vector<Occurrence> > &all_seeds){
-    FILE* fin = fopen(filename, "rb");
-    Seed s;
-    while(fread(&s, sizeof(s), 1, fin) == 1){
-	auto result = all_seeds.emplace(s.v, 1);
-	if(result.second == false){
-	    //if(result.first->second.back().read_id < read_id){
-	    result.first->second.emplace_back(read_id, s.pos);
-	    //}
-	}else{
-	    Occurrence* x = &(result.first->second[0]);
-	    x->read_id = read_id;
-	    x->pos = s.pos;
-	}
-    }
-    if(ferror(fin)){
-	fprintf(stderr, "Error reading %s\n", filename);
-    }
-    fclose(fin);
-}
-
-
-int main(int argc, const char * argv[])    
-{   
-    if(argc != 3){
-	printf("usage: overlapBySeedsPos.out seedsDir numFiles\n");
-	return 1;
-    }
-
-    int n = atoi(argv[2]);
-    //int threshold = atoi(argv[3]);
-
-
-    char filename[500];
-    int i = strlen(argv[1]);
-    memcpy(filename, argv[1], i);
-    if(filename[i-1] != '/'){
-	filename[i] = '/';
-	++i;
-    }
-    
-    map<kmer, vector<Occurrence> > all_seeds;
-    int j;
-    
-    struct stat test_file;
-    for(j=1; j<=n; j+=1){
-	sprintf(filename+i, "%d.subseqseed", j);
-	if(stat(filename, &test_file) != 0){//seed file does not exist
-	    fprintf(stderr, "Stopped, cannot find file %d.subseqseed\n", j);
-	    break;
-	}
-	loadSubseqSeedsPos(filename, j, all_seeds);
-    }
-
-    sprintf(filename+i, "overlapPos-n%d.all-pair", n);
-
-    Table share_ct(n);
-    Table share_ct_rev(n);
-
-    int a, b, c;
-    
-    for(auto& seed : all_seeds){
-	c = seed.second.size();
-	if(c > 1){
-	    sort(seed.second.begin(), seed.second.end());
-	    a = seed.second[0].read_id;
-	    for(i=1; i<c; ++i){
-		b = seed.second[i].read_id;
-		if(a < b) ++ share_ct.access(a, b);
-		else if (b < a) ++ share_ct_rev.access(b, a);
-		a = b;
-		// if(share_ct.access(a, b) == threshold){
-		// fprintf(fout, "%d %d\n", a, b);
-		// }
-	    }
-	}
-    }
-
-    share_ct.saveNoneZeroEntries(filename);
-    share_ct_rev.saveNoneZeroEntries(filename, "a", true);
-
-    //sort the output
-    char cmd[2000];
-    //sprintf(cmd, "sort -k1g,2 -k2g,3 -o %s %s", filename, filename);
-    sprintf(cmd, "bash -c 'sort -k1g,2 -k2g,3 -o %s{,}'", filename);
-    return system(cmd);
-}
+/*
+  Given a seed directory (see SeedStore.h), 
+  output pairs of reads with the number of unique seeds they share.
+  To avoid reporting transitive overlapping pairs, for each seed, 
+  reads containing it are sorted in reverse order according to the 
+  position of the seed. Only adjacent pairs in this order are counted. 
+  The k-mer type is read from the store, the optional k is only needed
+  for seeds in one file per read with k > 64 (stored as longkmer). No
+  output is written if the seeds cannot be loaded.
+  
+  By: Ke@PSU
+  Last edited: 04/07/2023
+*/
+
+#include "util.h"
+#include "SeedStore.h"
+#include "SeedIndex.h"
+#include "PairCounter.h"
+#include "ThreadPool.h"
+#include <cstdlib>
+#include <iostream>
+#include <fstream>
+#include <thread>
+
+using namespace std;
+
+struct Occurrence{
+    int read_id;
+    unsigned int pos;
+
+    Occurrence(): read_id(0), pos(0){}
+    Occurrence(const int id, const unsigned int pos): read_id(id), pos(pos){}
+    Occurrence(const Occurrence& o): read_id(o.read_id), pos(o.pos){}
+    bool operator < (const Occurrence& x) const{
+	return pos > x.pos;
+    }
+};
+
+/*
+  Load the seeds of reads 1..n of the seed directory into an index, the
+  seeds are of the k-mer type T (see util.h). Each distinct seed has all
+  its occurrences, in ascending order of read ids. Return false if the
+  store fails (e.g., the seeds are of another k-mer type).
+*/
+template<class T>
+static bool loadAllSeedsPos(SeedStore& store, const int n,
+			    SeedIndex<T>& index){
+    const SeedT<T>* seeds;
+    size_t count;
+    int j;
+    
+    for(j=1; j<=n; j+=1){
+	seeds = store.getSeeds<T>(j, count);
+	if(seeds == NULL){//no seeds stored for the read
+	    fprintf(stderr, "Stopped, cannot find the seeds of read %d\n", j);
+	    break;
+	}
+	index.add(seeds, count, j);
+    }
+    if(!store.good()) return false;
+    index.build();
+    return true;
+}
+
+/*
+  Count the seeds shared by the pairs of reads 1..n that are adjacent in
+  the order of the occurrences of a seed, in share_ct if the first read
+  has the smaller id, in share_ct_rev otherwise. The seeds are split
+  among the threads, each with counters of its own. Return false if the
+  seeds cannot be loaded.
+*/
+template<class T>
+static bool countSharedSeedsPos(SeedStore& store, const int n,
+				PairCounter& share_ct,
+				PairCounter& share_ct_rev){
+    SeedIndex<T> index;
+    if(!loadAllSeedsPos(store, n, index)) return false;
+
+    int num_threads = availableCpus(), t;
+    vector<PairCounter> counters(num_threads, PairCounter(n));
+    vector<PairCounter> counters_rev(num_threads, PairCounter(n));
+
+    auto countSeeds = [&](const int t){
+	PairCounter& ct = counters[t];
+	PairCounter& ct_rev = counters_rev[t];
+	vector<Occurrence> occ;
+	const int* reads;
+	const unsigned int* pos;
+	size_t s;
+	int a, b, c, i;
+
+	for(s=t; s<index.size(); s+=num_threads){
+	    c = index.count(s);
+	    if(c > 1){
+		reads = index.readIds(s);
+		pos = index.positions(s);
+		occ.clear();
+		for(i=0; i<c; ++i){
+		    occ.emplace_back(reads[i], pos[i]);
+		}
+		sort(occ.begin(), occ.end());
+		a = occ[0].read_id;
+		for(i=1; i<c; ++i){
+		    b = occ[i].read_id;
+		    if(a < b) ct.add(a, b);
+		    else if (b < a) ct_rev.add(b, a);
+		    a = b;
+		}
+	    }
+	}
+    };
+    vector<thread> minions;
+    for(t=1; t<num_threads; ++t){
+	minions.emplace_back(countSeeds, t);
+    }
+    countSeeds(0);
+    for(auto& x : minions){
+	x.join();
+    }
+
+    for(t=0; t<num_threads; ++t){
+	share_ct.merge(counters[t]);
+	share_ct_rev.merge(counters_rev[t]);
+    }
+    return true;
+}
+
+int main(int argc, const char * argv[])    
+{   
+    if(argc != 3 && argc != 4){
+	printf("usage: overlapBySeedsPos.out seedsDir numFiles [k]\n");
+	return 1;
+    }
+
+    int n = atoi(argv[2]);
+    int k = argc == 4 ? atoi(argv[3]) : 0;
+    //int threshold = atoi(argv[3]);
+
+
+    char filename[500];
+    int i = strlen(argv[1]);
+    memcpy(filename, argv[1], i);
+    if(filename[i-1] != '/'){
+	filename[i] = '/';
+	++i;
+    }
+    
+    SeedStore store(argv[1]);
+    if(!store.good()) return 1;
+    if(store.isStore()){//the k-mer type is known from the store
+	if(k > 0 && k != store.k()){
+	    fprintf(stderr, "The seeds are stored with k=%d, not %d\n",
+		    store.k(), k);
+	    return 1;
+	}
+	k = store.k();
+    }
+
+    sprintf(filename+i, "overlapPos-n%d.all-pair", n);
+
+    PairCounter share_ct(n);
+    PairCounter share_ct_rev(n);
+    bool loaded = k > 64
+	? countSharedSeedsPos<longkmer>(store, n, share_ct, share_ct_rev)
+	: countSharedSeedsPos<kmer>(store, n, share_ct, share_ct_rev);
+    if(!loaded) return 1;
+
+    share_ct.saveNoneZeroEntries(filename);
+    share_ct_rev.saveNoneZeroEntries(filename, "a", true);
+
+    //sort the output
+    char cmd[2000];
+    //sprintf(cmd, "sort -k1g,2 -k2g,3 -o %s %s", filename, filename);
+    sprintf(cmd, "bash -c 'sort -k1g,2 -k2g,3 -o %s{,}'", filename);
+    return system(cmd);
+}
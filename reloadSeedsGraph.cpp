@@ -14,13 +14,28 @@
 
 using namespace std;
 
-typedef SeedsGraph<kmer> Graph;
-
-string kmerToString(const kmer& x, unsigned int k, char* buf){
+//T is kmer, or longkmer for k > 64 (see util.h)
+template<class T>
+string kmerToString(const T& x, unsigned int k, char* buf){
     decode(x, k, buf);
     return string(buf);
 }
 
+template<class T>
+static int reloadGraph(const char* graph_file, const unsigned int k){
+    SeedsGraph<T> g;
+    g.loadGraph(graph_file);
+
+    char filename[200];
+    sprintf(filename, "%s-withloc.dot", graph_file);
+
+    char buf[k+1];
+    buf[k] = '\0';
+    g.saveGraphToDot(filename, kmerToString<T>, k, buf);
+    
+    return 0;
+}
+
 int main(int argc, const char * argv[])
 {
     if(argc != 3){
@@ -30,16 +45,7 @@ int main(int argc, const char * argv[])
 
     unsigned int k = atoi(argv[2]);
 
-    Graph g;
-    g.loadGraph(argv[1]);
-
-    char filename[200];
-    sprintf(filename, "%s-withloc.dot", argv[1]);
-
-    char buf[k+1];
-    buf[k] = '\0';
-    g.saveGraphToDot(filename, kmerToString, k, buf);
-    
-    return 0;
+    if(k > 64) return reloadGraph<longkmer>(argv[1], k);
+    else return reloadGraph<kmer>(argv[1], k);
 }
 
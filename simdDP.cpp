@@ -0,0 +1,767 @@
+#include "simdDP.h"
+#include <cmath>
+#include <immintrin.h>
+
+/*
+  All kernels take the folded random tables (see FoldedRandTable)
+  --sa[j][c]: A if B2 else -A, the value added when choosing c at row j;
+  --sm[j][c]: sign bit mask of double, 0 if B1 else flips the sign;
+  --codes[i][l]: alphabetIndex of char i of lane l (0 for unused lanes).
+  The value of a cell chosen from the previous cell x is (x ^ sm) + sa,
+  which is exactly (B1 ? x : -x) + (B2 ? A : -A) as in fillDPTable.
+*/
+typedef void (*DPBatchKernel)(const int n, const int k,
+			      const double* sa, const uint64_t* sm,
+			      const int32_t* codes, DPBatch& dp);
+
+static void fillDPTableBatchScalar(const int n, const int k,
+				   const double* sa, const uint64_t* sm,
+				   const int32_t* codes, DPBatch& dp){
+    int del = n-k, d, j, l, c, q, prev, up;
+    double* mn = dp.min.data();
+    double* mx = dp.max.data();
+    uint8_t* fl = dp.flags.data();
+    double v1, v2, lo, hi, cur_min, cur_max;
+    uint8_t lt, tmin, tmax;
+
+    for(d=0; d<=del; ++d){
+	for(j=1, q=dpIndex(k, d+1, 1), prev=q-1, up=q-(k+1);
+	    j<=k; ++j, ++q, ++prev, ++up){
+	    lt = tmin = tmax = 0;
+	    for(l=0; l<DPBATCHLANES; ++l){
+		c = access2d(ALPHABETSIZE, j-1,
+			     codes[access2d(DPBATCHLANES, d+j-1, l)]);
+		if(d > 0){
+		    cur_min = mn[up*DPBATCHLANES+l];
+		    cur_max = mx[up*DPBATCHLANES+l];
+		}else{
+		    cur_min = 1e15;
+		    cur_max = -1e15;
+		}
+		v1 = foldedStep(mn[prev*DPBATCHLANES+l], sm[c], sa[c]);
+		v2 = foldedStep(mx[prev*DPBATCHLANES+l], sm[c], sa[c]);
+		if(v1 < v2){
+		    lt |= 1<<l;
+		    lo = v1;
+		    hi = v2;
+		}else{
+		    lo = v2;
+		    hi = v1;
+		}
+		if(lo <= cur_min){
+		    tmin |= 1<<l;
+		    cur_min = lo;
+		}
+		if(hi >= cur_max){
+		    tmax |= 1<<l;
+		    cur_max = hi;
+		}
+		mn[q*DPBATCHLANES+l] = cur_min;
+		mx[q*DPBATCHLANES+l] = cur_max;
+	    }
+	    fl[(q<<2)+DPFLAG_MAXPRE] = tmax;
+	    fl[(q<<2)+DPFLAG_MINPRE] = tmin;
+	    fl[(q<<2)+DPFLAG_MAXMAX] = (tmax & lt) | ~tmax;
+	    fl[(q<<2)+DPFLAG_MINMAX] = tmin & ~lt;
+	}
+    }
+}
+
+__attribute__((target("avx2")))
+static void fillDPTableBatchAVX2(const int n, const int k,
+				 const double* sa, const uint64_t* sm,
+				 const int32_t* codes, DPBatch& dp){
+    int del = n-k, d, j, q, prev, up;
+    double* mn = dp.min.data();
+    double* mx = dp.max.data();
+    uint8_t* fl = dp.flags.data();
+    const __m256d big = _mm256_set1_pd(1e15), nbig = _mm256_set1_pd(-1e15);
+    const __m256d zero = _mm256_setzero_pd();
+    const __m256d all = _mm256_castsi256_pd(_mm256_set1_epi64x(-1));
+    __m128i idx[2];
+    __m256d a, m, cur_min, cur_max, v1, v2, lo, hi, lt, tmin, tmax;
+    int h, mlt, mtmin, mtmax;
+    uint8_t flt, ftmin, ftmax;
+
+    for(d=0; d<=del; ++d){
+	for(j=1, q=dpIndex(k, d+1, 1), prev=q-1, up=q-(k+1);
+	    j<=k; ++j, ++q, ++prev, ++up){
+	    flt = ftmin = ftmax = 0;
+	    //two groups of 4 lanes
+	    for(h=0; h<2; ++h){
+		idx[h] = _mm_loadu_si128((const __m128i*)
+					 (codes + access2d(DPBATCHLANES, d+j-1, h<<2)));
+		a = _mm256_mask_i32gather_pd(zero, sa + ((j-1)<<2),
+					     idx[h], all, 8);
+		m = _mm256_mask_i32gather_pd(zero, (const double*)(sm + ((j-1)<<2)),
+					     idx[h], all, 8);
+		if(d > 0){
+		    cur_min = _mm256_loadu_pd(mn+up*DPBATCHLANES+(h<<2));
+		    cur_max = _mm256_loadu_pd(mx+up*DPBATCHLANES+(h<<2));
+		}else{
+		    cur_min = big;
+		    cur_max = nbig;
+		}
+		v1 = _mm256_xor_pd(_mm256_loadu_pd(mn+prev*DPBATCHLANES+(h<<2)), m);
+		v2 = _mm256_xor_pd(_mm256_loadu_pd(mx+prev*DPBATCHLANES+(h<<2)), m);
+		v1 = _mm256_add_pd(v1, a);
+		v2 = _mm256_add_pd(v2, a);
+		lt = _mm256_cmp_pd(v1, v2, _CMP_LT_OQ);
+		lo = _mm256_blendv_pd(v2, v1, lt);
+		hi = _mm256_blendv_pd(v1, v2, lt);
+		tmin = _mm256_cmp_pd(lo, cur_min, _CMP_LE_OQ);
+		tmax = _mm256_cmp_pd(hi, cur_max, _CMP_GE_OQ);
+		_mm256_storeu_pd(mn+q*DPBATCHLANES+(h<<2),
+				 _mm256_blendv_pd(cur_min, lo, tmin));
+		_mm256_storeu_pd(mx+q*DPBATCHLANES+(h<<2),
+				 _mm256_blendv_pd(cur_max, hi, tmax));
+		mlt = _mm256_movemask_pd(lt);
+		mtmin = _mm256_movemask_pd(tmin);
+		mtmax = _mm256_movemask_pd(tmax);
+		flt |= mlt << (h<<2);
+		ftmin |= mtmin << (h<<2);
+		ftmax |= mtmax << (h<<2);
+	    }
+	    fl[(q<<2)+DPFLAG_MAXPRE] = ftmax;
+	    fl[(q<<2)+DPFLAG_MINPRE] = ftmin;
+	    fl[(q<<2)+DPFLAG_MAXMAX] = (ftmax & flt) | ~ftmax;
+	    fl[(q<<2)+DPFLAG_MINMAX] = ftmin & ~flt;
+	}
+    }
+}
+
+__attribute__((target("avx512f")))
+static void fillDPTableBatchAVX512(const int n, const int k,
+				   const double* sa, const uint64_t* sm,
+				   const int32_t* codes, DPBatch& dp){
+    int del = n-k, d, j, q, prev, up;
+    double* mn = dp.min.data();
+    double* mx = dp.max.data();
+    uint8_t* fl = dp.flags.data();
+    const __m512d big = _mm512_set1_pd(1e15), nbig = _mm512_set1_pd(-1e15);
+    const __m512d zero = _mm512_setzero_pd();
+    __m256i idx;
+    __m512d a, cur_min, cur_max, v1, v2, lo, hi;
+    __m512i m;
+    __mmask8 lt, tmin, tmax;
+
+    for(d=0; d<=del; ++d){
+	for(j=1, q=dpIndex(k, d+1, 1), prev=q-1, up=q-(k+1);
+	    j<=k; ++j, ++q, ++prev, ++up){
+	    idx = _mm256_loadu_si256((const __m256i*)
+				     (codes + access2d(DPBATCHLANES, d+j-1, 0)));
+	    a = _mm512_mask_i32gather_pd(zero, 0xff, idx, sa + ((j-1)<<2), 8);
+	    m = _mm512_castpd_si512(_mm512_mask_i32gather_pd(
+		zero, 0xff, idx, (const double*)(sm + ((j-1)<<2)), 8));
+	    if(d > 0){
+		cur_min = _mm512_loadu_pd(mn+up*DPBATCHLANES);
+		cur_max = _mm512_loadu_pd(mx+up*DPBATCHLANES);
+	    }else{
+		cur_min = big;
+		cur_max = nbig;
+	    }
+	    v1 = _mm512_castsi512_pd(_mm512_xor_si512(
+		_mm512_castpd_si512(_mm512_loadu_pd(mn+prev*DPBATCHLANES)), m));
+	    v2 = _mm512_castsi512_pd(_mm512_xor_si512(
+		_mm512_castpd_si512(_mm512_loadu_pd(mx+prev*DPBATCHLANES)), m));
+	    v1 = _mm512_add_pd(v1, a);
+	    v2 = _mm512_add_pd(v2, a);
+	    lt = _mm512_cmp_pd_mask(v1, v2, _CMP_LT_OQ);
+	    lo = _mm512_mask_blend_pd(lt, v2, v1);
+	    hi = _mm512_mask_blend_pd(lt, v1, v2);
+	    tmin = _mm512_cmp_pd_mask(lo, cur_min, _CMP_LE_OQ);
+	    tmax = _mm512_cmp_pd_mask(hi, cur_max, _CMP_GE_OQ);
+	    _mm512_storeu_pd(mn+q*DPBATCHLANES,
+			     _mm512_mask_blend_pd(tmin, cur_min, lo));
+	    _mm512_storeu_pd(mx+q*DPBATCHLANES,
+			     _mm512_mask_blend_pd(tmax, cur_max, hi));
+	    fl[(q<<2)+DPFLAG_MAXPRE] = tmax;
+	    fl[(q<<2)+DPFLAG_MINPRE] = tmin;
+	    fl[(q<<2)+DPFLAG_MAXMAX] = (tmax & lt) | (uint8_t)~tmax;
+	    fl[(q<<2)+DPFLAG_MINMAX] = tmin & (uint8_t)~lt;
+	}
+    }
+}
+
+/*
+  Kernels of the integer mode, same as above with IntRandTable, i.e.,
+  --sa[j][c]: the int32 A (already negated if !B2);
+  --sn[j][c]: 0 if B1 else -1, x is negated as (x ^ sn) - sn.
+  The scalar kernel accumulates in int64 and serves as the reference.
+*/
+typedef void (*DPBatchIntKernel)(const int n, const int k,
+				 const int32_t* sa, const int32_t* sn,
+				 const int32_t* codes, DPBatchInt& dp);
+
+static void fillDPTableBatchIntScalar(const int n, const int k,
+				      const int32_t* sa, const int32_t* sn,
+				      const int32_t* codes, DPBatchInt& dp){
+    int del = n-k, d, j, l, c, q, prev, up;
+    int32_t* mn = dp.min.data();
+    int32_t* mx = dp.max.data();
+    uint16_t* fl = dp.flags.data();
+    int64_t v1, v2, lo, hi, cur_min, cur_max;
+    uint16_t lt, tmin, tmax;
+
+    for(d=0; d<=del; ++d){
+	for(j=1, q=dpIndex(k, d+1, 1), prev=q-1, up=q-(k+1);
+	    j<=k; ++j, ++q, ++prev, ++up){
+	    lt = tmin = tmax = 0;
+	    for(l=0; l<DPBATCHLANESINT; ++l){
+		c = access2d(ALPHABETSIZE, j-1,
+			     codes[access2d(DPBATCHLANESINT, d+j-1, l)]);
+		if(d > 0){
+		    cur_min = mn[up*DPBATCHLANESINT+l];
+		    cur_max = mx[up*DPBATCHLANESINT+l];
+		}else{
+		    cur_min = INT32_MAX;
+		    cur_max = INT32_MIN;
+		}
+		v1 = intFoldedStep(mn[prev*DPBATCHLANESINT+l], sn[c], sa[c]);
+		v2 = intFoldedStep(mx[prev*DPBATCHLANESINT+l], sn[c], sa[c]);
+		if(v1 < v2){
+		    lt |= 1<<l;
+		    lo = v1;
+		    hi = v2;
+		}else{
+		    lo = v2;
+		    hi = v1;
+		}
+		if(lo <= cur_min){
+		    tmin |= 1<<l;
+		    cur_min = lo;
+		}
+		if(hi >= cur_max){
+		    tmax |= 1<<l;
+		    cur_max = hi;
+		}
+		mn[q*DPBATCHLANESINT+l] = cur_min;
+		mx[q*DPBATCHLANESINT+l] = cur_max;
+	    }
+	    fl[(q<<2)+DPFLAG_MAXPRE] = tmax;
+	    fl[(q<<2)+DPFLAG_MINPRE] = tmin;
+	    fl[(q<<2)+DPFLAG_MAXMAX] = (tmax & lt) | (uint16_t)~tmax;
+	    fl[(q<<2)+DPFLAG_MINMAX] = tmin & (uint16_t)~lt;
+	}
+    }
+}
+
+__attribute__((target("avx2")))
+static void fillDPTableBatchIntAVX2(const int n, const int k,
+				    const int32_t* sa, const int32_t* sn,
+				    const int32_t* codes, DPBatchInt& dp){
+    int del = n-k, d, j, q, prev, up;
+    int32_t* mn = dp.min.data();
+    int32_t* mx = dp.max.data();
+    uint16_t* fl = dp.flags.data();
+    const __m256i big = _mm256_set1_epi32(INT32_MAX);
+    const __m256i nbig = _mm256_set1_epi32(INT32_MIN);
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i all = _mm256_set1_epi32(-1);
+    __m256i idx, a, m, cur_min, cur_max, v1, v2, lo, hi, lt, gmin, gmax;
+    int h;
+    uint16_t flt, ftmin, ftmax;
+
+    for(d=0; d<=del; ++d){
+	for(j=1, q=dpIndex(k, d+1, 1), prev=q-1, up=q-(k+1);
+	    j<=k; ++j, ++q, ++prev, ++up){
+	    flt = ftmin = ftmax = 0;
+	    //two groups of 8 lanes
+	    for(h=0; h<2; ++h){
+		idx = _mm256_loadu_si256((const __m256i*)
+					 (codes + access2d(DPBATCHLANESINT, d+j-1, h<<3)));
+		a = _mm256_mask_i32gather_epi32(zero, (const int*)(sa + ((j-1)<<2)),
+						idx, all, 4);
+		m = _mm256_mask_i32gather_epi32(zero, (const int*)(sn + ((j-1)<<2)),
+						idx, all, 4);
+		if(d > 0){
+		    cur_min = _mm256_loadu_si256((const __m256i*)
+						 (mn+up*DPBATCHLANESINT+(h<<3)));
+		    cur_max = _mm256_loadu_si256((const __m256i*)
+						 (mx+up*DPBATCHLANESINT+(h<<3)));
+		}else{
+		    cur_min = big;
+		    cur_max = nbig;
+		}
+		v1 = _mm256_loadu_si256((const __m256i*)(mn+prev*DPBATCHLANESINT+(h<<3)));
+		v2 = _mm256_loadu_si256((const __m256i*)(mx+prev*DPBATCHLANESINT+(h<<3)));
+		v1 = _mm256_add_epi32(_mm256_sub_epi32(_mm256_xor_si256(v1, m), m), a);
+		v2 = _mm256_add_epi32(_mm256_sub_epi32(_mm256_xor_si256(v2, m), m), a);
+		lt = _mm256_cmpgt_epi32(v2, v1);
+		lo = _mm256_min_epi32(v1, v2);
+		hi = _mm256_max_epi32(v1, v2);
+		//the complements of lo <= cur_min and hi >= cur_max
+		gmin = _mm256_cmpgt_epi32(lo, cur_min);
+		gmax = _mm256_cmpgt_epi32(cur_max, hi);
+		_mm256_storeu_si256((__m256i*)(mn+q*DPBATCHLANESINT+(h<<3)),
+				    _mm256_min_epi32(lo, cur_min));
+		_mm256_storeu_si256((__m256i*)(mx+q*DPBATCHLANESINT+(h<<3)),
+				    _mm256_max_epi32(hi, cur_max));
+		flt |= _mm256_movemask_ps(_mm256_castsi256_ps(lt)) << (h<<3);
+		ftmin |= _mm256_movemask_ps(_mm256_castsi256_ps(gmin)) << (h<<3);
+		ftmax |= _mm256_movemask_ps(_mm256_castsi256_ps(gmax)) << (h<<3);
+	    }
+	    ftmin = ~ftmin;
+	    ftmax = ~ftmax;
+	    fl[(q<<2)+DPFLAG_MAXPRE] = ftmax;
+	    fl[(q<<2)+DPFLAG_MINPRE] = ftmin;
+	    fl[(q<<2)+DPFLAG_MAXMAX] = (ftmax & flt) | (uint16_t)~ftmax;
+	    fl[(q<<2)+DPFLAG_MINMAX] = ftmin & (uint16_t)~flt;
+	}
+    }
+}
+
+__attribute__((target("avx512f")))
+static void fillDPTableBatchIntAVX512(const int n, const int k,
+				      const int32_t* sa, const int32_t* sn,
+				      const int32_t* codes, DPBatchInt& dp){
+    int del = n-k, d, j, q, prev, up;
+    int32_t* mn = dp.min.data();
+    int32_t* mx = dp.max.data();
+    uint16_t* fl = dp.flags.data();
+    const __m512i big = _mm512_set1_epi32(INT32_MAX);
+    const __m512i nbig = _mm512_set1_epi32(INT32_MIN);
+    const __m512i zero = _mm512_setzero_si512();
+    __m512i idx, a, m, cur_min, cur_max, v1, v2, lo, hi;
+    __mmask16 lt, tmin, tmax;
+
+    for(d=0; d<=del; ++d){
+	for(j=1, q=dpIndex(k, d+1, 1), prev=q-1, up=q-(k+1);
+	    j<=k; ++j, ++q, ++prev, ++up){
+	    idx = _mm512_loadu_si512(codes + access2d(DPBATCHLANESINT, d+j-1, 0));
+	    a = _mm512_mask_i32gather_epi32(zero, 0xffff, idx,
+					    sa + ((j-1)<<2), 4);
+	    m = _mm512_mask_i32gather_epi32(zero, 0xffff, idx,
+					    sn + ((j-1)<<2), 4);
+	    if(d > 0){
+		cur_min = _mm512_loadu_si512(mn+up*DPBATCHLANESINT);
+		cur_max = _mm512_loadu_si512(mx+up*DPBATCHLANESINT);
+	    }else{
+		cur_min = big;
+		cur_max = nbig;
+	    }
+	    v1 = _mm512_loadu_si512(mn+prev*DPBATCHLANESINT);
+	    v2 = _mm512_loadu_si512(mx+prev*DPBATCHLANESINT);
+	    v1 = _mm512_add_epi32(_mm512_sub_epi32(_mm512_xor_si512(v1, m), m), a);
+	    v2 = _mm512_add_epi32(_mm512_sub_epi32(_mm512_xor_si512(v2, m), m), a);
+	    lt = _mm512_cmp_epi32_mask(v1, v2, _MM_CMPINT_LT);
+	    lo = _mm512_min_epi32(v1, v2);
+	    hi = _mm512_max_epi32(v1, v2);
+	    tmin = _mm512_cmp_epi32_mask(lo, cur_min, _MM_CMPINT_LE);
+	    tmax = _mm512_cmp_epi32_mask(hi, cur_max, _MM_CMPINT_NLT);
+	    _mm512_storeu_si512(mn+q*DPBATCHLANESINT, _mm512_min_epi32(lo, cur_min));
+	    _mm512_storeu_si512(mx+q*DPBATCHLANESINT, _mm512_max_epi32(hi, cur_max));
+	    fl[(q<<2)+DPFLAG_MAXPRE] = tmax;
+	    fl[(q<<2)+DPFLAG_MINPRE] = tmin;
+	    fl[(q<<2)+DPFLAG_MAXMAX] = (tmax & lt) | (uint16_t)~tmax;
+	    fl[(q<<2)+DPFLAG_MINMAX] = tmin & (uint16_t)~lt;
+	}
+    }
+}
+
+#define DPKERNEL_SCALAR 0
+#define DPKERNEL_AVX2 1
+#define DPKERNEL_AVX512 2
+
+static const char* const dp_batch_kernel_names[] = {"scalar", "avx2", "avx512"};
+static const DPBatchKernel dp_batch_kernels[] = {
+    fillDPTableBatchScalar, fillDPTableBatchAVX2, fillDPTableBatchAVX512};
+static const DPBatchIntKernel dp_batch_int_kernels[] = {
+    fillDPTableBatchIntScalar, fillDPTableBatchIntAVX2, fillDPTableBatchIntAVX512};
+
+static int pickDPBatchKernel(){
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx512f")) return DPKERNEL_AVX512;
+    if(__builtin_cpu_supports("avx2")) return DPKERNEL_AVX2;
+    return DPKERNEL_SCALAR;
+}
+
+static int getDPBatchKernel(){
+    static const int kernel = pickDPBatchKernel();
+    return kernel;
+}
+
+const char* dpBatchKernelName(){
+    return dp_batch_kernel_names[getDPBatchKernel()];
+}
+
+void fillDPTableBatch(const char* s, const int n, const int k,
+		      const FoldedRandTable& ft, const int lanes,
+		      DPBatch& dp){
+    int32_t codes[n*DPBATCHLANES];
+    int i, l;
+
+    for(i=0; i<n; ++i){
+	for(l=0; l<DPBATCHLANES; ++l){
+	    codes[access2d(DPBATCHLANES, i, l)] =
+		l < lanes ? alphabetIndex(s[l+i]) : 0;
+	}
+    }
+
+    dp_batch_kernels[getDPBatchKernel()](n, k, ft.A.data(), ft.sign.data(),
+					 codes, dp);
+}
+
+double getScoreFromDPBatch(const int n, const int k,
+			   const DPBatch& dp, const int lane){
+    int q = dpIndex(k, n, k)*DPBATCHLANES + lane;
+    double score = fabs(dp.min[q]);
+    if(score < dp.max[q]) return dp.max[q];
+    else return score;
+}
+
+//S is const char* or PackedSeq, see util.h
+template<class T, class S>
+static inline bool backtrackDPTableBatchOf(const S& s, const int n,
+					   const int k, const DPBatch& dp,
+					   const int lane, T* result){
+    *result = 0;
+    int i = 0, cur = n;
+    bool select, from_max;
+    const uint8_t* fl = dp.flags.data();
+
+    int q = dpIndex(k, n, k);
+    double score = fabs(dp.min[q*DPBATCHLANES+lane]);
+    if(dp.max[q*DPBATCHLANES+lane] > score){
+	select = (fl[(q<<2)+DPFLAG_MAXPRE] >> lane) & 1;
+	from_max = (fl[(q<<2)+DPFLAG_MAXMAX] >> lane) & 1;
+    }else{
+	select = (fl[(q<<2)+DPFLAG_MINPRE] >> lane) & 1;
+	from_max = (fl[(q<<2)+DPFLAG_MINMAX] >> lane) & 1;
+    }
+
+    while(i < (k<<1)){
+	if(select){
+	    setKmerBase(*result, i, baseAt(s, cur-1));
+	    i += 2;
+	    q -= 1; //[i][j] to [i-1][j-1]
+	}else{
+	    q -= (k+1); //[i][j] to [i-1][j]
+	}
+	cur -= 1;
+
+	if(from_max){
+	    select = (fl[(q<<2)+DPFLAG_MAXPRE] >> lane) & 1;
+	    from_max = (fl[(q<<2)+DPFLAG_MAXMAX] >> lane) & 1;
+	}else{
+	    select = (fl[(q<<2)+DPFLAG_MINPRE] >> lane) & 1;
+	    from_max = (fl[(q<<2)+DPFLAG_MINMAX] >> lane) & 1;
+	}
+    }
+
+    return (q == 0);
+}
+
+template<class T>
+bool backtrackDPTableBatch(const char* s, const int n, const int k,
+			   const DPBatch& dp, const int lane, T* result){
+    return backtrackDPTableBatchOf(s, n, k, dp, lane, result);
+}
+
+template<class T>
+bool backtrackDPTableBatch(const PackedSeq& s, const int n, const int k,
+			   const DPBatch& dp, const int lane, T* result){
+    return backtrackDPTableBatchOf(s, n, k, dp, lane, result);
+}
+
+template<class T>
+void getSubseqSeedsThresholdBatch(const std::string &read,
+				  const int n, const int k,
+				  const RandTableCell* tp,
+				  const double threshold,
+				  std::vector<SeedT<T> >& seeds_list){
+    if(read.length() < (size_t)n) return;
+
+    const char* s = read.c_str();
+    unsigned int i, last = read.length() - n;
+    int l, lanes;
+    T seed;
+    DPBatch dp(n, k);
+    FoldedRandTable ft(k, tp);
+
+    for(i=0; i<=last; i+=DPBATCHLANES){
+	lanes = std::min(DPBATCHLANES, (int)(last-i+1));
+	fillDPTableBatch(s+i, n, k, ft, lanes, dp);
+	for(l=0; l<lanes; ++l){
+	    if(getScoreFromDPBatch(n, k, dp, l) >= threshold){
+		backtrackDPTableBatch(s+i+l, n, k, dp, l, &seed);
+		storeSeedWithPosInVector(seed, i+l, seeds_list);
+	    }
+	}
+    }
+}
+
+template<class T, class S>
+static void getSubseqSeedsThresholdBatchMultiOf(
+    const S& s, const size_t len, const int n, const int k, const int r,
+    const RandTableCell* const* tps, const double threshold,
+    std::vector<SeedT<T> >* seeds_lists){
+    if(len < (size_t)n) return;
+
+    size_t num = (len-n+1) * r, p, base;
+    unsigned int w[DPBATCHLANES];
+    int t[DPBATCHLANES], i, l, lanes;
+    int32_t codes[n*DPBATCHLANES];
+    T seed;
+    DPBatch dp(n, k);
+
+    //the r tables stacked as one table of r*k rows, lane l of table t
+    //uses the code t*k*ALPHABETSIZE + alphabetIndex
+    FoldedRandTable ft(r*k);
+    for(i=0; i<r; ++i){
+	FoldedRandTable one(k, tps[i]);
+	std::copy(one.A.begin(), one.A.end(), ft.A.begin() + i*k*ALPHABETSIZE);
+	std::copy(one.sign.begin(), one.sign.end(),
+		  ft.sign.begin() + i*k*ALPHABETSIZE);
+    }
+    //decode the read once for all tables
+    std::vector<uint8_t> rc(len);
+    for(p=0; p<len; ++p){
+	rc[p] = baseAt(s, p);
+    }
+
+    //pair p is window p/r with table p%r, the pairs are processed
+    //DPBATCHLANES at a time, unused lanes repeat the first pair
+    for(base=0; base<num; base+=DPBATCHLANES){
+	lanes = std::min((size_t)DPBATCHLANES, num-base);
+	for(l=0; l<DPBATCHLANES; ++l){
+	    p = base + (l < lanes ? l : 0);
+	    w[l] = p / r;
+	    t[l] = p % r;
+	}
+	for(i=0; i<n; ++i){
+	    for(l=0; l<DPBATCHLANES; ++l){
+		codes[access2d(DPBATCHLANES, i, l)] =
+		    t[l]*k*ALPHABETSIZE + rc[w[l]+i];
+	    }
+	}
+	dp_batch_kernels[getDPBatchKernel()](n, k, ft.A.data(), ft.sign.data(),
+					     codes, dp);
+
+	for(l=0; l<lanes; ++l){
+	    if(getScoreFromDPBatch(n, k, dp, l) >= threshold){
+		backtrackDPTableBatch(s+w[l], n, k, dp, l, &seed);
+		storeSeedWithPosInVector(seed, w[l], seeds_lists[t[l]]);
+	    }
+	}
+    }
+}
+
+template<class T>
+void getSubseqSeedsThresholdBatchMulti(const std::string &read,
+				       const int n, const int k, const int r,
+				       const RandTableCell* const* tps,
+				       const double threshold,
+				       std::vector<SeedT<T> >* seeds_lists){
+    getSubseqSeedsThresholdBatchMultiOf(read.c_str(), read.length(), n, k, r,
+					tps, threshold, seeds_lists);
+}
+
+template<class T>
+void getSubseqSeedsThresholdBatchMulti(const PackedSeq& s, const size_t len,
+				       const int n, const int k, const int r,
+				       const RandTableCell* const* tps,
+				       const double threshold,
+				       std::vector<SeedT<T> >* seeds_lists){
+    getSubseqSeedsThresholdBatchMultiOf(s, len, n, k, r, tps, threshold,
+					seeds_lists);
+}
+
+template<class T>
+void getSubseqSeedsThresholdBatchCanonical(const std::string &read,
+					   const int n, const int k,
+					   const RandTableCell* tp,
+					   const double threshold,
+					   std::vector<SeedT<T> >& seeds_list){
+    if(read.length() < (size_t)n) return;
+
+    const char* s = read.c_str();
+    size_t len = read.length(), num = (len-n+1) << 1, p, base;
+    unsigned int w[DPBATCHLANES];
+    int i, l, lanes;
+    int32_t codes[n*DPBATCHLANES];
+    double score_f, score_r;
+    T seed, seed_r;
+    bool strand;
+    DPBatch dp(n, k);
+    FoldedRandTable ft(k, tp);
+
+    //the read is decoded once, the reverse complement only needs to be
+    //spelled out for backtracking
+    std::vector<uint8_t> rc(len);
+    std::string rev(len, 'A');
+    for(p=0; p<len; ++p){
+	rc[p] = alphabetIndex(s[p]);
+	rev[len-1-p] = ALPHABET[3-rc[p]];
+    }
+    const char* r = rev.c_str();
+
+    //pair p is window p/2 on the forward (p even) or the reverse (p odd)
+    //strand; DPBATCHLANES is even so both strands of a window are in the
+    //same batch, unused lanes repeat the first pair
+    for(base=0; base<num; base+=DPBATCHLANES){
+	lanes = std::min((size_t)DPBATCHLANES, num-base);
+	for(l=0; l<DPBATCHLANES; ++l){
+	    w[l] = (base + (l < lanes ? l : 0)) >> 1;
+	}
+	for(i=0; i<n; ++i){
+	    for(l=0; l<DPBATCHLANES; l+=2){
+		codes[access2d(DPBATCHLANES, i, l)] = rc[w[l]+i];
+		codes[access2d(DPBATCHLANES, i, l+1)] = 3 - rc[w[l]+n-1-i];
+	    }
+	}
+	dp_batch_kernels[getDPBatchKernel()](n, k, ft.A.data(), ft.sign.data(),
+					     codes, dp);
+
+	//the strand with the higher score (the smaller seed on a tie) wins,
+	//so a window and its reverse complement get the same seed
+	for(l=0; l<lanes; l+=2){
+	    score_f = getScoreFromDPBatch(n, k, dp, l);
+	    score_r = getScoreFromDPBatch(n, k, dp, l+1);
+	    if(score_f < threshold && score_r < threshold) continue;
+
+	    strand = score_r > score_f;
+	    backtrackDPTableBatch(strand ? r+len-n-w[l] : s+w[l], n, k,
+				  dp, l+strand, &seed);
+	    if(score_r == score_f){
+		backtrackDPTableBatch(r+len-n-w[l], n, k, dp, l+1, &seed_r);
+		if(seed_r < seed){
+		    seed = seed_r;
+		    strand = true;
+		}
+	    }
+	    storeSeedWithPosInVector(seed, w[l], seeds_list, strand);
+	}
+    }
+}
+
+void fillDPTableBatchInt(const char* s, const int n, const int k,
+			 const IntRandTable& it, const int lanes,
+			 DPBatchInt& dp){
+    int32_t codes[n*DPBATCHLANESINT];
+    int i, l;
+
+    for(i=0; i<n; ++i){
+	for(l=0; l<DPBATCHLANESINT; ++l){
+	    codes[access2d(DPBATCHLANESINT, i, l)] =
+		l < lanes ? alphabetIndex(s[l+i]) : 0;
+	}
+    }
+
+    dp_batch_int_kernels[getDPBatchKernel()](n, k, it.A.data(), it.neg.data(),
+					     codes, dp);
+}
+
+int64_t getScoreFromDPBatchInt(const int n, const int k,
+			       const DPBatchInt& dp, const int lane){
+    int q = dpIndex(k, n, k)*DPBATCHLANESINT + lane;
+    int64_t mn = dp.min[q], mx = dp.max[q];
+    if(-mn < mx) return mx;
+    else return -mn;
+}
+
+template<class T>
+bool backtrackDPTableBatchInt(const char* s, const int n, const int k,
+			      const DPBatchInt& dp, const int lane,
+			      T* result){
+    *result = 0;
+    int i = 0, cur = n;
+    bool select, from_max;
+    const uint16_t* fl = dp.flags.data();
+
+    int q = dpIndex(k, n, k);
+    int64_t mn = dp.min[q*DPBATCHLANESINT+lane];
+    if(dp.max[q*DPBATCHLANESINT+lane] > -mn){
+	select = (fl[(q<<2)+DPFLAG_MAXPRE] >> lane) & 1;
+	from_max = (fl[(q<<2)+DPFLAG_MAXMAX] >> lane) & 1;
+    }else{
+	select = (fl[(q<<2)+DPFLAG_MINPRE] >> lane) & 1;
+	from_max = (fl[(q<<2)+DPFLAG_MINMAX] >> lane) & 1;
+    }
+
+    while(i < (k<<1)){
+	if(select){
+	    setKmerBase(*result, i, alphabetIndex(s[cur-1]));
+	    i += 2;
+	    q -= 1; //[i][j] to [i-1][j-1]
+	}else{
+	    q -= (k+1); //[i][j] to [i-1][j]
+	}
+	cur -= 1;
+
+	if(from_max){
+	    select = (fl[(q<<2)+DPFLAG_MAXPRE] >> lane) & 1;
+	    from_max = (fl[(q<<2)+DPFLAG_MAXMAX] >> lane) & 1;
+	}else{
+	    select = (fl[(q<<2)+DPFLAG_MINPRE] >> lane) & 1;
+	    from_max = (fl[(q<<2)+DPFLAG_MINMAX] >> lane) & 1;
+	}
+    }
+
+    return (q == 0);
+}
+
+template<class T>
+void getSubseqSeedsThresholdBatchInt(const std::string &read,
+				     const int n, const int k,
+				     const IntRandTable& it,
+				     const double threshold,
+				     std::vector<SeedT<T> >& seeds_list){
+    if(read.length() < (size_t)n) return;
+
+    const char* s = read.c_str();
+    unsigned int i, last = read.length() - n;
+    int l, lanes;
+    T seed;
+    DPBatchInt dp(n, k);
+
+    for(i=0; i<=last; i+=DPBATCHLANESINT){
+	lanes = std::min(DPBATCHLANESINT, (int)(last-i+1));
+	fillDPTableBatchInt(s+i, n, k, it, lanes, dp);
+	for(l=0; l<lanes; ++l){
+	    //in the units of the double tables, exact in double
+	    if(ldexp(getScoreFromDPBatchInt(n, k, dp, l), it.shift) >= threshold){
+		backtrackDPTableBatchInt(s+i+l, n, k, dp, l, &seed);
+		storeSeedWithPosInVector(seed, i+l, seeds_list);
+	    }
+	}
+    }
+}
+
+//the k-mer types of the templates above, see util.h
+#define INSTANTIATE(T) \
+    template bool backtrackDPTableBatch<T>(const char* s, const int n, \
+					   const int k, const DPBatch& dp, \
+					   const int lane, T* result); \
+    template void getSubseqSeedsThresholdBatch<T>( \
+	const std::string &read, const int n, const int k, \
+	const RandTableCell* tp, const double threshold, \
+	std::vector<SeedT<T> >& seeds_list); \
+    template bool backtrackDPTableBatch<T>(const PackedSeq& s, \
+					   const int n, const int k, \
+					   const DPBatch& dp, \
+					   const int lane, T* result); \
+    template void getSubseqSeedsThresholdBatchMulti<T>( \
+	const std::string &read, const int n, const int k, const int r, \
+	const RandTableCell* const* tps, const double threshold, \
+	std::vector<SeedT<T> >* seeds_lists); \
+    template void getSubseqSeedsThresholdBatchMulti<T>( \
+	const PackedSeq& s, const size_t len, const int n, const int k, \
+	const int r, const RandTableCell* const* tps, \
+	const double threshold, std::vector<SeedT<T> >* seeds_lists); \
+    template void getSubseqSeedsThresholdBatchCanonical<T>( \
+	const std::string &read, const int n, const int k, \
+	const RandTableCell* tp, const double threshold, \
+	std::vector<SeedT<T> >& seeds_list); \
+    template bool backtrackDPTableBatchInt<T>(const char* s, const int n, \
+					      const int k, \
+					      const DPBatchInt& dp, \
+					      const int lane, T* result); \
+    template void getSubseqSeedsThresholdBatchInt<T>( \
+	const std::string &read, const int n, const int k, \
+	const IntRandTable& it, const double threshold, \
+	std::vector<SeedT<T> >& seeds_list);
+
+INSTANTIATE(kmer)
+INSTANTIATE(longkmer)
+#undef INSTANTIATE
@@ -0,0 +1,170 @@
+/*
+  Batched version of the dynamic programming in util.h: the dp tables of
+  up to DPBATCHLANES consecutive windows of a read are filled in lockstep,
+  one window per SIMD lane. The kernel is selected at runtime according
+  to the cpu (AVX-512, AVX2, or a portable scalar loop), the results are
+  bit-identical to fillDPTable/backtrackDPTable in all cases.
+
+  Last edited: 10/16/2026
+*/
+
+#ifndef _SIMDDP_H
+#define _SIMDDP_H 1
+
+#include "util.h"
+#include <cstdint>
+
+#define DPBATCHLANES 8
+
+/*
+  Structure-of-arrays dp tables of a batch of windows, banded as DPTable.
+  --min/max of cell q=dpIndex(k,i,j) of lane l are at [q*DPBATCHLANES + l];
+  --flags[q*4 + f] holds the traceback bools of cell q, bit l for lane l,
+    where f is one of the DPFLAG* below.
+  Column 0 is all zeros and is never written.
+*/
+#define DPFLAG_MAXPRE 0 //max_choose_pre
+#define DPFLAG_MINPRE 1 //min_choose_pre
+#define DPFLAG_MAXMAX 2 //max_from_max
+#define DPFLAG_MINMAX 3 //min_from_max
+
+struct DPBatch{
+    int n, k;
+    std::vector<double> min, max;
+    std::vector<uint8_t> flags;
+
+    DPBatch(const int n, const int k):
+	n(n), k(k), min((n-k+1)*(k+1)*DPBATCHLANES),
+	max((n-k+1)*(k+1)*DPBATCHLANES), flags((n-k+1)*(k+1)*4) {};
+};
+
+/*
+  Name of the kernel picked for this cpu: "avx512", "avx2" or "scalar".
+*/
+const char* dpBatchKernelName();
+
+/*
+  Fill the dp tables of the n-mers s+l for l=0..lanes-1 (lane l), i.e.,
+  s is assumed to have at least n+lanes-1 chars. Lanes at or beyond
+  lanes are filled with garbage and should be ignored.
+  --ft is the folded RandTableCell[k][ALPHABETSIZE];
+  --dp must be constructed with at least the same n and k.
+*/
+void fillDPTableBatch(const char* s, const int n, const int k,
+		      const FoldedRandTable& ft, const int lanes,
+		      DPBatch& dp);
+
+/*
+  Score (max absolute value) at [n][k] of the given lane.
+*/
+double getScoreFromDPBatch(const int n, const int k,
+			   const DPBatch& dp, const int lane);
+
+/*
+  Same as backtrackDPTable on the table of the given lane,
+  s is the n-mer of this lane (not of lane 0).
+*/
+template<class T>
+bool backtrackDPTableBatch(const char* s, const int n, const int k,
+			   const DPBatch& dp, const int lane, T* result);
+template<class T>
+bool backtrackDPTableBatch(const PackedSeq& s, const int n, const int k,
+			   const DPBatch& dp, const int lane, T* result);
+
+/*
+  Same as getSubseqSeedsThreshold (identical seeds and positions), with
+  the windows processed DPBATCHLANES at a time by fillDPTableBatch.
+*/
+template<class T>
+void getSubseqSeedsThresholdBatch(const std::string &read,
+				  const int n, const int k,
+				  const RandTableCell* tp,
+				  const double threshold,
+				  std::vector<SeedT<T> >& seeds_list);
+
+/*
+  Seeds of the same read with r sets of random tables in a single pass,
+  seeds_lists[t] receives the same seeds as getSubseqSeedsThresholdBatch
+  with the tables tps[t]. The read is decoded once and the dp tables of
+  all (window, table) pairs are interleaved in the lanes of the batches.
+  --tps[t] is RandTableCell[k][ALPHABETSIZE] flattened, t=0..r-1;
+  --seeds_lists is std::vector<SeedT<T> >[r].
+*/
+template<class T>
+void getSubseqSeedsThresholdBatchMulti(const std::string &read,
+				       const int n, const int k, const int r,
+				       const RandTableCell* const* tps,
+				       const double threshold,
+				       std::vector<SeedT<T> >* seeds_lists);
+
+/*
+  Same as above on the len chars of a packed read from s (e.g., a chunk
+  of it), the positions of the seeds are relative to s.
+*/
+template<class T>
+void getSubseqSeedsThresholdBatchMulti(const PackedSeq& s, const size_t len,
+				       const int n, const int k, const int r,
+				       const RandTableCell* const* tps,
+				       const double threshold,
+				       std::vector<SeedT<T> >* seeds_lists);
+
+/*
+  Strand-aware seeds in a single pass: both window s[w..w+n) and its
+  reverse complement are scored (in the lanes of the same batch), the
+  one with the higher score is kept, ties are broken by the smaller seed.
+  The seed is therefore canonical, i.e., the same for a window and its
+  reverse complement, and Seed::strand is 1 if it is from the reverse
+  complement. A window is kept if either strand passes the threshold,
+  pos is always the start of the window on the forward strand.
+*/
+template<class T>
+void getSubseqSeedsThresholdBatchCanonical(const std::string &read,
+					   const int n, const int k,
+					   const RandTableCell* tp,
+					   const double threshold,
+					   std::vector<SeedT<T> >& seeds_list);
+
+/*
+  Integer scoring mode (see IntRandTable): the dp values fit in int32, so
+  a batch has twice as many lanes as DPBatch. Laid out as DPBatch with
+  DPBATCHLANESINT lanes, flags are 16-bit masks.
+*/
+#define DPBATCHLANESINT 16
+
+struct DPBatchInt{
+    int n, k;
+    std::vector<int32_t> min, max;
+    std::vector<uint16_t> flags;
+
+    DPBatchInt(const int n, const int k):
+	n(n), k(k), min((n-k+1)*(k+1)*DPBATCHLANESINT),
+	max((n-k+1)*(k+1)*DPBATCHLANESINT), flags((n-k+1)*(k+1)*4) {};
+};
+
+/*
+  Same as fillDPTableBatch/getScoreFromDPBatch/backtrackDPTableBatch with
+  the integer tables. The kernels give the same results on every cpu.
+*/
+void fillDPTableBatchInt(const char* s, const int n, const int k,
+			 const IntRandTable& it, const int lanes,
+			 DPBatchInt& dp);
+int64_t getScoreFromDPBatchInt(const int n, const int k,
+			       const DPBatchInt& dp, const int lane);
+template<class T>
+bool backtrackDPTableBatchInt(const char* s, const int n, const int k,
+			      const DPBatchInt& dp, const int lane,
+			      T* result);
+
+/*
+  Seeds of the integer scoring mode, a window produces a seed if its
+  score times 2^shift is at least threshold (i.e., the threshold is in
+  the same units as for the double tables).
+*/
+template<class T>
+void getSubseqSeedsThresholdBatchInt(const std::string &read,
+				     const int n, const int k,
+				     const IntRandTable& it,
+				     const double threshold,
+				     std::vector<SeedT<T> >& seeds_list);
+
+#endif // simdDP.h
@@ -1,23 +1,23 @@
 #include "util.h"
 
-kmer encode(const char* s, const int k){
-    kmer enc = 0lu;
+template<class T>
+T encode(const char* s, const int k){
+    T enc = 0lu;
     int i;
     for(i=0; i<k; i+=1){
-	enc = (enc << 2) | alphabetIndex(s[i]);
+	setKmerBase(enc, (k-1-i)<<1, alphabetIndex(s[i]));
     }
     return enc;
 }
 
-char* decode(const kmer enc, const int k, char* str){
+template<class T>
+char* decode(const T enc, const int k, char* str){
     if(str == NULL){
 	str = (char*)malloc(sizeof *str *k);
     }
-    kmer enc_copy = enc;
     int i;
     for(i=k-1; i>=0; i-=1){
-	str[i] = ALPHABET[enc_copy & 3];
-	enc_copy >>= 2;
+	str[i] = ALPHABET[getKmerBase(enc, (k-1-i)<<1)];
     }
     return str;
 }
@@ -72,6 +72,103 @@ void loadRandTable(const char* filename, const int k, RandTableCell* tp){
     fclose(fin);
 }
 
+FoldedRandTable::FoldedRandTable(const int k, const RandTableCell* tp):
+    FoldedRandTable(k){
+    for(int q=0; q<k*ALPHABETSIZE; ++q){
+	A[q] = tp[q].B2 ? tp[q].A : -tp[q].A;
+	sign[q] = tp[q].B1 ? 0 : DOUBLESIGNBIT;
+    }
+}
+
+void quantizeRandTable(const int k, const RandTableCell* tp,
+		       IntRandTable& it){
+    int q;
+    it = IntRandTable(k);
+    while((1<<it.shift) < k) ++it.shift;
+    for(q=0; q<k*ALPHABETSIZE; ++q){
+	it.A[q] = (int32_t)ldexp(tp[q].A, -it.shift);
+	if(!tp[q].B2) it.A[q] = -it.A[q];
+	it.neg[q] = tp[q].B1 ? 0 : -1;
+    }
+}
+
+void saveIntRandTable(const char* filename, const IntRandTable& it){
+    FILE* fout = fopen(filename, "wb");
+    uint32_t version = INTRANDTABLEVERSION;
+    int32_t a;
+    uint8_t b;
+    
+    fwrite(INTRANDTABLEMAGIC, 1, 4, fout);
+    fwrite(&version, sizeof version, 1, fout);
+    fwrite(&it.k, sizeof it.k, 1, fout);
+    fwrite(&it.shift, sizeof it.shift, 1, fout);
+    for(int q=0; q<it.k*ALPHABETSIZE; ++q){
+	a = abs(it.A[q]);
+	fwrite(&a, sizeof a, 1, fout);
+	b = (it.neg[q] == 0); //B1
+	fwrite(&b, sizeof b, 1, fout);
+	b = (it.A[q] > 0); //B2
+	fwrite(&b, sizeof b, 1, fout);
+    }
+    fclose(fout);
+}
+
+bool loadIntRandTable(const char* filename, const int k, IntRandTable& it){
+    FILE* fin = fopen(filename, "rb");
+    if(fin == NULL){
+	fprintf(stderr, "Cannot open %s\n", filename);
+	return false;
+    }
+    
+    char magic[4];
+    uint32_t version;
+    int32_t file_k, shift, a;
+    uint8_t b1, b2;
+    bool ok = fread(magic, 1, 4, fin) == 4
+	&& memcmp(magic, INTRANDTABLEMAGIC, 4) == 0
+	&& fread(&version, sizeof version, 1, fin) == 1
+	&& fread(&file_k, sizeof file_k, 1, fin) == 1
+	&& fread(&shift, sizeof shift, 1, fin) == 1;
+    if(!ok){
+	fprintf(stderr, "%s is not an integer rand table\n", filename);
+	fclose(fin);
+	return false;
+    }
+    if(version != INTRANDTABLEVERSION || file_k != k){
+	fprintf(stderr, "%s has version %u and k=%d, expecting %u and %d\n",
+		filename, version, file_k, INTRANDTABLEVERSION, k);
+	fclose(fin);
+	return false;
+    }
+
+    //every dp value is bounded by the sum of the largest |A| of each row
+    int i, c, q;
+    int64_t sum = 0, max_a;
+    it = IntRandTable(k);
+    it.shift = shift;
+    for(i=0; ok && i<k; ++i){
+	for(c=0, max_a=0; ok && c<ALPHABETSIZE; ++c){
+	    q = access2d(ALPHABETSIZE, i, c);
+	    ok = fread(&a, sizeof a, 1, fin) == 1
+		&& fread(&b1, sizeof b1, 1, fin) == 1
+		&& fread(&b2, sizeof b2, 1, fin) == 1 && a >= 0;
+	    it.A[q] = b2 ? a : -a;
+	    it.neg[q] = b1 ? 0 : -1;
+	    max_a = std::max(max_a, (int64_t)a);
+	}
+	sum += max_a;
+    }
+    if(!ok){
+	fprintf(stderr, "Rand tables in %s are too small or corrupted\n",
+		filename);
+    }else if(sum > INT32_MAX){
+	fprintf(stderr, "Rand tables in %s may overflow int32\n", filename);
+	ok = false;
+    }
+    fclose(fin);
+    return ok;
+}
+
 void printRandTable(const int k, const RandTableCell* tp){
     int i, j, q;
     for(i=0; i<k; i+=1){
@@ -93,230 +190,359 @@ void printRandTable(const int k, const RandTableCell* tp){
 }
 
 
-double getSeedScore(const kmer seed, const int k, const RandTableCell* tp){
+template<class T>
+double getSeedScore(const T seed, const int k, const RandTableCell* tp){
     double omega = 0;
 
     int i, cur, q;
     for(i=0; i<k; ++i){
-	cur = (seed >> ((k-i-1)<<1)) & 3;
+	cur = getKmerBase(seed, (k-i-1)<<1);
 	q = access2d(ALPHABETSIZE, i, cur);
-	omega = (tp[q].B1 ? omega : -omega) + (tp[q].B2 ? tp[q].A : -tp[q].A);
+	omega = foldedStep(omega, (uint64_t)!tp[q].B1 << 63,
+			   ((tp[q].B2<<1) - 1) * tp[q].A);
     }
 
     return fabs(omega);
 }
 
+template<class T>
+int64_t getSeedScore(const T seed, const int k, const IntRandTable& it){
+    int64_t omega = 0;
+
+    int i, cur, q;
+    for(i=0; i<k; ++i){
+	cur = getKmerBase(seed, (k-i-1)<<1);
+	q = access2d(ALPHABETSIZE, i, cur);
+	omega = intFoldedStep(omega, it.neg[q], it.A[q]);
+    }
+
+    return omega < 0 ? -omega : omega;
+}
+
+template<class T>
+double getSeedScore(const T seed, const int k, const FoldedRandTable& ft){
+    double omega = 0;
+
+    int i, cur, q;
+    for(i=0; i<k; ++i){
+	cur = getKmerBase(seed, (k-i-1)<<1);
+	q = access2d(ALPHABETSIZE, i, cur);
+	omega = foldedStep(omega, ft.sign[q], ft.A[q]);
+    }
+
+    return fabs(omega);
+}
+
+/*
+  Fill the cell q=[i][j] from q-1=[i-1][j-1] and up=[i-1][j], the char
+  s[i-1] at row j-1 has the folded table entry (sign, a).
+  --up_valid is false if [i-1][j] is not a meaningful cell (i.e., i-1 < j).
+*/
+static inline void fillDPCell(const bool up_valid, const uint64_t sign,
+			      const double a, const size_t q, const size_t up,
+			      DPTable& dp){
+    double v1, v2, lo, hi, cur_min, cur_max;
+    bool lt, tmin, tmax;
+    uint8_t bits;
+
+    //dp[i][j] = dp[i-1][j]
+    cur_min = up_valid ? dp.min[up] : 1e15;
+    cur_max = up_valid ? dp.max[up] : -1e15;
+
+    //compare with dp[i-1][j-1]
+    v1 = foldedStep(dp.min[q-1], sign, a);
+    v2 = foldedStep(dp.max[q-1], sign, a);
+    lt = v1 < v2;
+    lo = lt ? v1 : v2;
+    hi = lt ? v2 : v1;
+    tmin = lo <= cur_min;
+    tmax = hi >= cur_max;
+    dp.min[q] = tmin ? lo : cur_min;
+    dp.max[q] = tmax ? hi : cur_max;
+
+    //a value kept from [i-1][j] is its max (resp. min); if up is not
+    //valid, both values are always taken from [i-1][j-1]
+    bits = (tmax ? DPTRACE_MAXPRE | (lt ? DPTRACE_MAXMAX : 0) : DPTRACE_MAXMAX)
+	| (tmin ? DPTRACE_MINPRE | (lt ? 0 : DPTRACE_MINMAX) : 0);
+    uint8_t& byte = dp.trace[q>>1];
+    byte = (byte & (0xf0 >> ((q&1)<<2))) | (bits << ((q&1)<<2));
+}
+
+static inline uint8_t getDPTrace(const DPTable& dp, const size_t q){
+    return (dp.trace[q>>1] >> ((q&1)<<2)) & 0xf;
+}
+
+/*
+  Fill the diagonal d of the dp table, i.e., cells [d+j][j] for j=0..k,
+  diagonal d-1 must have been filled.
+  --codes[j] is the alphabetIndex of s[d+j], j=0..k-1.
+*/
+static inline void fillDPDiagonal(const int* codes, const int d, const int k,
+				  const FoldedRandTable& ft, DPTable& dp){
+    int j, c;
+    size_t q = dpIndex(k, d, 0);
+
+    dp.min[q] = dp.max[q] = 0;
+    for(j=1, ++q; j<=k; ++j, ++q){
+	c = access2d(ALPHABETSIZE, j-1, codes[j-1]);
+	fillDPCell(d > 0, ft.sign[c], ft.A[c], q, q-(k+1), dp);
+    }
+}
+
+/*
+  The dp functions below are written for S = const char* or PackedSeq, the
+  chars of a window are only read by baseAt.
+*/
+template<class S>
+static inline void fillDPTableOf(const S& s, const int n, const int k,
+				 const FoldedRandTable& ft, DPTable& dp){
+    int codes[n], i;
+    for(i=0; i<n; ++i){
+	codes[i] = baseAt(s, i);
+    }
+    
+    //[i][j] only depends on [i-1][j-1] (same diagonal) and [i-1][j]
+    //(previous diagonal)
+    for(i=0; i<=n-k; ++i){
+	fillDPDiagonal(codes+i, i, k, ft, dp);
+    }
+}//end fillDPTable
+
 void fillDPTable(const char* s, const int n, const int k,
-		 const RandTableCell* tp, DPCell* dpp){
-    int del = n-k, i, j, c, q;
+		 const FoldedRandTable& ft, DPTable& dp){
+    fillDPTableOf(s, n, k, ft, dp);
+}
+
+void fillDPTable(const PackedSeq& s, const int n, const int k,
+		 const FoldedRandTable& ft, DPTable& dp){
+    fillDPTableOf(s, n, k, ft, dp);
+}
+
+void initSuffixBounds(const int k, const RandTableCell* tp, double* bound){
+    int i, j;
+    double a;
+    bound[k] = 0;
+    for(i=k-1; i>=0; --i){
+	a = 0;
+	for(j=0; j<ALPHABETSIZE; ++j){
+	    a = std::max(a, tp[access2d(ALPHABETSIZE, i, j)].A);
+	}
+	bound[i] = bound[i+1] + a;
+    }
+}
 
-    memset(dpp, 0, sizeof *dpp * (n+1) * (k+1));
+template<class S>
+static inline double scoreDPTableOf(const S& s, const int n, const int k,
+				    const FoldedRandTable& ft, double* rows,
+				    double* prev_score, const double* bound,
+				    const double threshold){
+    int del = n-k, i, j, c, q;
+    double* mn = rows;
+    double* mx = rows+k+1;
+    double v1, v2, lo, hi, best;
+    const double* sa = ft.A.data();
+    const uint64_t* sm = ft.sign.data();
 
-    c = alphabetIndex(s[0]);
-    q = access2d(k+1, 1, 1);
-    dpp[q].min = dpp[q].max = tp[c].B2 ? tp[c].A : -tp[c].A; //tp[0][c]
-    dpp[q].min_choose_pre = dpp[q].max_choose_pre = true;
+    memset(rows, 0, sizeof *rows * ((k+1)<<1));
+    c = baseAt(s, 0);
+    mn[1] = mx[1] = sa[c];
 
-    int minj, maxj, prev;
-    double v1, v2;
+    int minj, maxj;
     for(i=2; i<=n; ++i){
+	if(i == n && prev_score){
+	    *prev_score = std::max(fabs(mn[k]), mx[k]);
+	}
 	minj = std::max(1, i-del);
 	maxj = std::min(i, k);
-	
-	for(j=minj, q=access2d(k+1, i, minj), prev=access2d(k+1, i-1, minj-1);
-	    j<=maxj; ++j, ++q, ++prev){
-	    //dpp[i][j] = dpp[i-1][j]
-	    if(i-1 < j){//[i-1][j] is not a meaningful cell
-		dpp[q].min = 1e15;
-		dpp[q].max = -1e15;
-	    }else{
-		memcpy(&dpp[q], &dpp[prev+1], sizeof *dpp);
-		dpp[q].min_choose_pre = dpp[q].max_choose_pre = false;
-		dpp[q].max_from_max = true;
-		dpp[q].min_from_max = false;
+	c = baseAt(s, i-1);
+
+	//[i][j] only depends on [i-1][j] and [i-1][j-1], update in place
+	//from right to left
+	j = maxj;
+	q = access2d(ALPHABETSIZE, j-1, c);
+	if(j == i){//[i-1][j] is not a meaningful cell
+	    v1 = foldedStep(mn[j-1], sm[q], sa[q]);
+	    v2 = foldedStep(mx[j-1], sm[q], sa[q]);
+	    mn[j] = v1 < v2 ? v1 : v2;
+	    mx[j] = v1 < v2 ? v2 : v1;
+	    --j;
+	    q -= ALPHABETSIZE;
+	}
+	for(; j>=minj; --j, q-=ALPHABETSIZE){
+	    v1 = foldedStep(mn[j-1], sm[q], sa[q]);
+	    v2 = foldedStep(mx[j-1], sm[q], sa[q]);
+	    lo = v1 < v2 ? v1 : v2;
+	    hi = v1 < v2 ? v2 : v1;
+	    mn[j] = lo < mn[j] ? lo : mn[j];
+	    mx[j] = hi > mx[j] ? hi : mx[j];
+	}
+
+	//every path to [n][k] goes through one cell of this row, whose
+	//final score is at most max(|min|, |max|) + bound[j], the small
+	//relative slack absorbs rounding errors of the accumulated values;
+	//[i][0] (nothing selected yet) is valid while i <= del
+	if(bound && i < n){
+	    for(j=minj, best=(i<=del ? bound[0] : 0); j<=maxj; ++j){
+		v1 = std::max(-mn[j], mx[j]) + bound[j];
+		best = v1 > best ? v1 : best;
 	    }
-	    
-	    //compare with dpp[i-1][j-1]
-	    c = access2d(ALPHABETSIZE, j-1, alphabetIndex(s[i-1]));
-	    if(tp[c].B1){
-		v1 = dpp[prev].min;
-		v2 = dpp[prev].max;
-	    }else{
-		v1 = -dpp[prev].min;
-		v2 = -dpp[prev].max;
+	    if(best * (1+1e-12) < threshold){
+		if(prev_score) *prev_score = -1;
+		return -1;
 	    }
+	}
+    }
 
-	    if(tp[c].B2){
-		v1 += tp[c].A;
-		v2 += tp[c].A;
-	    }else{
-		v1 -= tp[c].A;
-		v2 -= tp[c].A;
-	    }
+    return std::max(fabs(mn[k]), mx[k]);
+}
 
-	    if(v1 < v2){
-		if(v1 <= dpp[q].min){
-		    dpp[q].min = v1;
-		    dpp[q].min_choose_pre = true;
-		    dpp[q].min_from_max = false;
-		}
-		if(v2 >= dpp[q].max){
-		    dpp[q].max = v2;
-		    dpp[q].max_choose_pre = true;
-		    dpp[q].max_from_max = true;
-		}
-	    }else{
-		if(v2 <= dpp[q].min){
-		    dpp[q].min = v2;
-		    dpp[q].min_choose_pre = true;
-		    dpp[q].min_from_max = true;
-		}
-		if(v1 >= dpp[q].max){
-		    dpp[q].max = v1;
-		    dpp[q].max_choose_pre = true;
-		    dpp[q].max_from_max = false;
-		}
-	    }
-	}//end for j
-    }//end for i    
-}//end fillDPTable
+double scoreDPTable(const char* s, const int n, const int k,
+		    const FoldedRandTable& ft, double* rows, double* prev_score,
+		    const double* bound/*=NULL*/, const double threshold/*=0*/){
+    return scoreDPTableOf(s, n, k, ft, rows, prev_score, bound, threshold);
+}
 
-bool backtrackDPTable(const char* s, const int n, const int k,
-		      const DPCell* dpp, kmer* result){
+double scoreDPTable(const PackedSeq& s, const int n, const int k,
+		    const FoldedRandTable& ft, double* rows, double* prev_score,
+		    const double* bound/*=NULL*/, const double threshold/*=0*/){
+    return scoreDPTableOf(s, n, k, ft, rows, prev_score, bound, threshold);
+}
+
+template<class T, class S>
+static inline bool backtrackDPTableOf(const S& s, const int n, const int k,
+				      const DPTable& dp, T* result){
     *result = 0;
-    kmer c;
     int i = 0, cur = n;
     bool select, from_max;
     
-    int q = access2d(k+1, n, k);
-    double score = fabs(dpp[q].min);
-    if(dpp[q].max > score){
-	score = dpp[q].max;
-	select = dpp[q].max_choose_pre;
-	from_max = dpp[q].max_from_max;
+    size_t q = dpIndex(k, n, k);
+    uint8_t t = getDPTrace(dp, q);
+    if(dp.max[q] > fabs(dp.min[q])){
+	select = t & DPTRACE_MAXPRE;
+	from_max = t & DPTRACE_MAXMAX;
     }else{
-	select = dpp[q].min_choose_pre;
-	from_max = dpp[q].min_from_max;
+	select = t & DPTRACE_MINPRE;
+	from_max = t & DPTRACE_MINMAX;
     }
 
     while(i < (k<<1)){
 	if(select){
-	    c = alphabetIndex(s[cur-1]);
-	    c <<= i;
-	    *result |= c;
+	    setKmerBase(*result, i, baseAt(s, cur-1));
 	    i += 2;
-	    q -= (k+2); //[i][j] to [i-1][j-1]
+	    q -= 1; //[i][j] to [i-1][j-1]
 	}else{
 	    q -= (k+1); //[i][j] to [i-1][j]
 	}
 	cur -= 1;
 	
+	t = getDPTrace(dp, q);
 	if(from_max){
-	    select = dpp[q].max_choose_pre;
-	    from_max = dpp[q].max_from_max;
+	    select = t & DPTRACE_MAXPRE;
+	    from_max = t & DPTRACE_MAXMAX;
 	}else{
-	    select = dpp[q].min_choose_pre;
-	    from_max = dpp[q].min_from_max;
+	    select = t & DPTRACE_MINPRE;
+	    from_max = t & DPTRACE_MINMAX;
 	}
     }
 
     return (q == 0);
 }
 
+template<class T>
+bool backtrackDPTable(const char* s, const int n, const int k,
+		      const DPTable& dp, T* result){
+    return backtrackDPTableOf(s, n, k, dp, result);
+}
+
+template<class T>
+bool backtrackDPTable(const PackedSeq& s, const int n, const int k,
+		      const DPTable& dp, T* result){
+    return backtrackDPTableOf(s, n, k, dp, result);
+}
+
+template<class T>
 bool backtrackDPTableWithPos(const char* s, const int n, const int k,
-			     const DPCell* dpp, kmer* result,
+			     const DPTable& dp, T* result,
 			     const int st, int* pos){
     *result = 0;
-    kmer c;
     int i = 0, cur = n;
     bool select, from_max;
     
-    int q = access2d(k+1, n, k);
-    double score = fabs(dpp[q].min);
-    if(dpp[q].max > score){
-	score = dpp[q].max;
-	select = dpp[q].max_choose_pre;
-	from_max = dpp[q].max_from_max;
+    size_t q = dpIndex(k, n, k);
+    uint8_t t = getDPTrace(dp, q);
+    if(dp.max[q] > fabs(dp.min[q])){
+	select = t & DPTRACE_MAXPRE;
+	from_max = t & DPTRACE_MAXMAX;
     }else{
-	select = dpp[q].min_choose_pre;
-	from_max = dpp[q].min_from_max;
+	select = t & DPTRACE_MINPRE;
+	from_max = t & DPTRACE_MINMAX;
     }
 
     while(i < (k<<1)){
 	if(select){
-	    c = alphabetIndex(s[cur-1]);
+	    setKmerBase(*result, i, alphabetIndex(s[cur-1]));
 	    pos[k-1-(i>>1)] = st + cur - 1;
-	    c <<= i;
-	    *result |= c;
 	    i += 2;
-	    q -= (k+2); //[i][j] to [i-1][j-1]
+	    q -= 1; //[i][j] to [i-1][j-1]
 	}else{
 	    q -= (k+1); //[i][j] to [i-1][j]
 	}
 	cur -= 1;
 	
+	t = getDPTrace(dp, q);
 	if(from_max){
-	    select = dpp[q].max_choose_pre;
-	    from_max = dpp[q].max_from_max;
+	    select = t & DPTRACE_MAXPRE;
+	    from_max = t & DPTRACE_MAXMAX;
 	}else{
-	    select = dpp[q].min_choose_pre;
-	    from_max = dpp[q].min_from_max;
+	    select = t & DPTRACE_MINPRE;
+	    from_max = t & DPTRACE_MINMAX;
 	}
     }
 
     return (q == 0);
 }
 
-static inline void storeSeedWithPosInVector(const kmer seed, const unsigned int pos,
-					    std::vector<Seed>& seeds_list){
-    //skip the same seed from consecutive positions
-    if(seeds_list.size() > 0){
-	Seed& s = seeds_list.back();
-	if(s.v == seed){
-	    ++ s.span;
-	    return;
-	}
-    }
-    seeds_list.emplace_back(seed, pos);
-}
-
 static inline double getScoreFromDPTable(const int n, const int k,
-					 const DPCell* dp){
-    int q = access2d(k+1, n, k);
-    double score = fabs(dp[q].min);
-    if(score < dp[q].max) return dp[q].max;
+					 const DPTable& dp){
+    size_t q = dpIndex(k, n, k);
+    double score = fabs(dp.min[q]);
+    if(score < dp.max[q]) return dp.max[q];
     else return score;
 }
 
+template<class T>
 void getSubseqSeedsThreshold(const std::string &read,
 			     const int n, const int k,
 			     const RandTableCell* tp, const double threshold,
-			     std::vector<Seed>& seeds_list){
+			     std::vector<SeedT<T> >& seeds_list){
+    const char* s = read.c_str();
     size_t len = read.length();
+    if(len < (size_t)n) return;
+
     unsigned int i;
-    char cur[n+1];
-    kmer seed;
+    T seed;
     double score = threshold;
     //calculate an extra column, can skip next position if score at
     //[n+1][k] does not reach threshold; otherwise does not need recalculation
     //if backtrack from [n+1][k] does not use first char
-    DPCell dp[(n+2)*(k+1)];
+    DPTable dp(n+1, k);
+    FoldedRandTable ft(k, tp);
 
     for(i=0; i<len-n; i+=1){
-	read.copy(cur, n+1, i);
-	fillDPTable(cur, n+1, k, tp, dp);
+	//the window is read in place, no copy
+	fillDPTable(s+i, n+1, k, ft, dp);
 	//printf("called at %d\n", i);
 
 	//get seed from pos i
 	score = getScoreFromDPTable(n, k, dp);
 	if(score >= threshold){
-	    backtrackDPTable(cur, n, k, dp, &seed);
+	    backtrackDPTable(s+i, n, k, dp, &seed);
 	    storeSeedWithPosInVector(seed, i, seeds_list);
 	}
 
 	score = getScoreFromDPTable(n+1, k, dp);
 	if(score >= threshold){
-	    if(!backtrackDPTable(cur, n+1, k, dp, &seed)){//first char not used
+	    if(!backtrackDPTable(s+i, n+1, k, dp, &seed)){//first char not used
 		++i; //skip recalculation of next position
 		storeSeedWithPosInVector(seed, i, seeds_list);
 	    }
@@ -328,74 +554,500 @@ void getSubseqSeedsThreshold(const std::string &read,
     //handle last seed, either it's never calculated or the previous
     //iteration did not work (i.e., score >= threshold but used 1st char)
     if(i == len - n){
-	read.copy(cur, n, i);
-	fillDPTable(cur, n, k, tp, dp);
+	fillDPTable(s+i, n, k, ft, dp);
 	//printf("called at %d\n", i);
 	score = getScoreFromDPTable(n, k, dp);
 	if(score >= threshold){
-	    backtrackDPTable(cur, n, k, dp, &seed);
+	    backtrackDPTable(s+i, n, k, dp, &seed);
 	    storeSeedWithPosInVector(seed, i, seeds_list);
 	}
     }
 }
 
-void saveSubseqSeeds(const char* filename,
-		     const std::vector<Seed>& seeds_list){
+template<class T, class S>
+static void getSubseqSeedsThresholdTwoTierOf(const S& s, const size_t len,
+					     const int n, const int k,
+					     const RandTableCell* tp,
+					     const double threshold,
+					     std::vector<SeedT<T> >& seeds_list,
+					     const double* bound,
+					     SeedingStats* stats){
+    if(len < (size_t)n) return;
+
+    unsigned int i;
+    T seed;
+    double score_n, score_n1;
+    double rows[(k+1)<<1];
+    DPTable dp(n+1, k);
+    FoldedRandTable ft(k, tp);
+    SeedingStats local;
+
+    local.windows = len - n + 1;
+    for(i=0; i<len-n; i+=1){
+	score_n1 = scoreDPTable(s+i, n+1, k, ft, rows, &score_n,
+				bound, threshold);
+	if(score_n1 < threshold){//neither window i nor i+1 has a seed
+	    if(score_n1 < 0) local.pruned += 2;
+	    ++i;
+	    continue;
+	}
+	
+	fillDPTable(s+i, n+1, k, ft, dp);
+	if(score_n >= threshold){
+	    backtrackDPTable(s+i, n, k, dp, &seed);
+	    storeSeedWithPosInVector(seed, i, seeds_list);
+	}
+	if(!backtrackDPTable(s+i, n+1, k, dp, &seed)){//first char not used
+	    ++i;
+	    storeSeedWithPosInVector(seed, i, seeds_list);
+	}
+    }
+
+    //last window, see getSubseqSeedsThreshold
+    if(i == len - n){
+	score_n = scoreDPTable(s+i, n, k, ft, rows, NULL, bound, threshold);
+	if(score_n >= threshold){
+	    fillDPTable(s+i, n, k, ft, dp);
+	    backtrackDPTable(s+i, n, k, dp, &seed);
+	    storeSeedWithPosInVector(seed, i, seeds_list);
+	}else if(score_n < 0){
+	    local.pruned += 1;
+	}
+    }
+
+    if(stats) *stats += local;
+}
+
+template<class T>
+void getSubseqSeedsThresholdTwoTier(const std::string &read,
+				    const int n, const int k,
+				    const RandTableCell* tp,
+				    const double threshold,
+				    std::vector<SeedT<T> >& seeds_list,
+				    const double* bound/*=NULL*/,
+				    SeedingStats* stats/*=NULL*/){
+    getSubseqSeedsThresholdTwoTierOf(read.c_str(), read.length(), n, k, tp,
+				     threshold, seeds_list, bound, stats);
+}
+
+template<class T>
+void getSubseqSeedsThresholdTwoTier(const PackedSeq& s, const size_t len,
+				    const int n, const int k,
+				    const RandTableCell* tp,
+				    const double threshold,
+				    std::vector<SeedT<T> >& seeds_list,
+				    const double* bound/*=NULL*/,
+				    SeedingStats* stats/*=NULL*/){
+    getSubseqSeedsThresholdTwoTierOf(s, len, n, k, tp, threshold, seeds_list,
+				     bound, stats);
+}
+
+PackedRead::PackedRead(const char* s, const size_t len):
+    len(len), words((len+31)>>5, 0){
+    size_t i, st;
+    for(i=0; i<len; ++i){
+	words[i>>5] |= (uint64_t)alphabetIndex(s[i]) << ((i&31)<<1);
+    }
+    for(i=0; i<len; ){
+	if(isValidBase(s[i])){
+	    ++i;
+	}else{
+	    for(st=i; i<len && !isValidBase(s[i]); ++i);
+	    invalid.emplace_back(st, i);
+	}
+    }
+}
+
+std::string PackedRead::unpack(const size_t st, const size_t l) const{
+    static const char INVALID[ALPHABETSIZE] = {'N', 'R', 'Y', 'K'};
+    size_t ed = std::min(st+l, len), i;
+    std::string s(ed > st ? ed-st : 0, 'A');
+    for(i=st; i<ed; ++i){
+	s[i-st] = ALPHABET[base(i)];
+    }
+    //runs are sorted, only those overlapping [st, ed) are changed
+    auto it = std::upper_bound(invalid.begin(), invalid.end(),
+			       std::make_pair((uint32_t)st, UINT32_MAX));
+    if(it != invalid.begin()) --it;
+    for(; it != invalid.end() && it->first < ed; ++it){
+	for(i=std::max((size_t)it->first, st); i<it->second && i<ed; ++i){
+	    s[i-st] = INVALID[base(i)];
+	}
+    }
+    return s;
+}
+
+void getValidSegments(const PackedRead& read, const size_t st,
+		      const size_t len, const int n,
+		      std::vector<std::pair<size_t, size_t> >& segments,
+		      SeedingStats* stats/*=NULL*/){
+    size_t ed = std::min(st+len, read.len), cur = st, a, valid = 0;
+    //the first run of invalid bases that may end after st
+    auto it = std::upper_bound(read.invalid.begin(), read.invalid.end(),
+			       std::make_pair((uint32_t)st, UINT32_MAX));
+    if(it != read.invalid.begin()) --it;
+
+    while(cur < ed){
+	if(it != read.invalid.end() && it->second <= cur){
+	    ++it;
+	    continue;
+	}
+	//the valid chars [cur, a) before the next run
+	a = it == read.invalid.end() ? ed
+	    : std::max(cur, std::min((size_t)it->first, ed));
+	if(a - cur >= (size_t)n){
+	    segments.emplace_back(cur-st, a-st);
+	    valid += a - cur - n + 1;
+	}
+	if(it == read.invalid.end()) break;
+	cur = it->second;
+	++it;
+    }
+
+    if(stats && ed >= st + n) stats->skipped += ed - st - n + 1 - valid;
+}
+
+void initModRandTable(const int k, const int p, ModRandTable& mt){
+    std::random_device rd;
+    std::vector<int> pos;
+    std::vector<int> possign;
+
+    int i, j, z, q;
+    for(i=0; i<ALPHABETSIZE; i+=1){
+	possign.push_back(i);
+    }
+    for(i=0; i<p; i+=1){
+	pos.push_back(i);
+    }
+
+    std::default_random_engine generator(rd());
+    std::uniform_real_distribution<double> distribution((int64_t)1<<30, (int64_t)1<<31);
+
+    mt = ModRandTable(k, p);
+    for(i=0; i<k; i+=1){
+	std::shuffle(pos.begin(), pos.end(), generator);
+	for(j=0; j<ALPHABETSIZE; j+=1){
+	    mt.shift[access2d(ALPHABETSIZE, i, j)] = pos[j];
+	}
+
+	for(z=0; z<p; z+=1){
+	    std::shuffle(possign.begin(), possign.end(), generator);
+	    for(j=0; j<ALPHABETSIZE; j+=1){
+		q = access2d(p, access2d(ALPHABETSIZE, i, j), z);
+		mt.A[q] = distribution(generator);
+		if(possign[j] / 2 == 0) mt.A[q] = -mt.A[q]; //B2
+		mt.sign[q] = possign[j] % 2 ? 0 : DOUBLESIGNBIT; //B1
+	    }
+	}
+    }
+}
+
+void saveModRandTable(const char* filename, const ModRandTable& mt){
     FILE* fout = fopen(filename, "wb");
-    for(const Seed& s : seeds_list){
-	fwrite(&s, sizeof(s), 1, fout);
+    uint32_t version = MODRANDTABLEVERSION;
+    int32_t shift;
+    double a;
+    uint8_t b;
+    int q;
+
+    fwrite(MODRANDTABLEMAGIC, 1, 4, fout);
+    fwrite(&version, sizeof version, 1, fout);
+    fwrite(&mt.k, sizeof mt.k, 1, fout);
+    fwrite(&mt.p, sizeof mt.p, 1, fout);
+    for(q=0; q<mt.k*ALPHABETSIZE; ++q){
+	shift = mt.shift[q];
+	fwrite(&shift, sizeof shift, 1, fout);
+    }
+    for(q=0; q<mt.k*ALPHABETSIZE*mt.p; ++q){
+	a = fabs(mt.A[q]);
+	fwrite(&a, sizeof a, 1, fout);
+	b = (mt.sign[q] == 0); //B1
+	fwrite(&b, sizeof b, 1, fout);
+	b = (mt.A[q] > 0); //B2
+	fwrite(&b, sizeof b, 1, fout);
     }
     fclose(fout);
 }
 
-void loadSubseqSeeds(const char* filename, const int read_id,
-		     std::map<kmer, std::vector<int> > &all_seeds){
+bool loadModRandTable(const char* filename, const int k, const int p,
+		      ModRandTable& mt){
     FILE* fin = fopen(filename, "rb");
-    Seed s;
-    while(fread(&s, sizeof(s), 1, fin) == 1){
-	auto result = all_seeds.emplace(s.v, std::move(std::vector<int>(1,read_id)));
-	if(result.second == false && result.first->second.back() < read_id){
-	    result.first->second.push_back(read_id);
-	}
+    if(fin == NULL){
+	fprintf(stderr, "Cannot open %s\n", filename);
+	return false;
+    }
+
+    char magic[4];
+    uint32_t version;
+    int32_t file_k, file_p, shift;
+    double a;
+    uint8_t b1, b2;
+    bool ok = fread(magic, 1, 4, fin) == 4
+	&& memcmp(magic, MODRANDTABLEMAGIC, 4) == 0
+	&& fread(&version, sizeof version, 1, fin) == 1
+	&& fread(&file_k, sizeof file_k, 1, fin) == 1
+	&& fread(&file_p, sizeof file_p, 1, fin) == 1;
+    if(!ok){
+	fprintf(stderr, "%s is not a modular rand table\n", filename);
+	fclose(fin);
+	return false;
+    }
+    if(version != MODRANDTABLEVERSION || file_k != k || file_p != p){
+	fprintf(stderr, "%s has version %u, k=%d and p=%d, expecting %u, %d and %d\n",
+		filename, version, file_k, file_p, MODRANDTABLEVERSION, k, p);
+	fclose(fin);
+	return false;
+    }
+
+    int q;
+    mt = ModRandTable(k, p);
+    for(q=0; ok && q<k*ALPHABETSIZE; ++q){
+	ok = fread(&shift, sizeof shift, 1, fin) == 1
+	    && shift >= 0 && shift < p;
+	mt.shift[q] = shift;
     }
-    if(ferror(fin)){
-	fprintf(stderr, "Error reading %s\n", filename);
+    for(q=0; ok && q<k*ALPHABETSIZE*p; ++q){
+	ok = fread(&a, sizeof a, 1, fin) == 1
+	    && fread(&b1, sizeof b1, 1, fin) == 1
+	    && fread(&b2, sizeof b2, 1, fin) == 1;
+	mt.A[q] = b2 ? a : -a;
+	mt.sign[q] = b1 ? 0 : DOUBLESIGNBIT;
+    }
+    if(!ok){
+	fprintf(stderr, "Rand tables in %s are too small or corrupted\n",
+		filename);
     }
     fclose(fin);
+    return ok;
 }
 
-Table::Table(size_t n): n(n){
-    size_t size = (n*(n-1))>>1;
-    arr = new unsigned int[size];
-    memset(arr, 0, sizeof *arr * size);
+ModDPTable::ModDPTable(const int n, const int k, const int p):
+    n(n), k(k), p(p), min((n-k+1)*(k+1)*p), max((n-k+1)*(k+1)*p),
+    trace((n-k+1)*(k+1)*p){
+    //column 0 (nothing selected yet) is in bucket 0 and is never written
+    for(int i=0; i<=n-k; ++i){
+	trace[dpIndex(k, i, 0)*p] = MODDP_REACHED;
+    }
 }
 
-Table::~Table(){
-    delete[] arr;
+void fillModDPTable(const char* s, const int n, const int k,
+		    const ModRandTable& mt, ModDPTable& dp){
+    const int p = mt.p;
+    int i, j, z, c, y, minj, maxj;
+    size_t q, up, pre, r;
+    double v1, v2, lo, hi, cur_min, cur_max;
+    bool lt, tmin, tmax;
+    uint8_t bits;
+
+    for(i=1; i<=n; ++i){
+	minj = i-(n-k) > 1 ? i-(n-k) : 1;
+	maxj = i < k ? i : k;
+	c = alphabetIndex(s[i-1]);
+
+	for(j=minj; j<=maxj; ++j){
+	    q = dpIndex(k, i, j) * p;
+	    r = access2d(ALPHABETSIZE, j-1, c);
+	    //bucket z of [i][j] comes from bucket (z+y)%p of [i-1][j-1]
+	    y = p - mt.shift[r];
+
+	    for(z=0; z<p; ++z){
+		//dp[i][j][z] = dp[i-1][j][z], [i-1][j] is meaningful if i > j
+		up = q - (k+1)*p + z;
+		if(i > j && (dp.trace[up] & MODDP_REACHED)){
+		    cur_min = dp.min[up];
+		    cur_max = dp.max[up];
+		    bits = MODDP_REACHED | DPTRACE_MAXMAX;
+		}else{
+		    cur_min = 1e15;
+		    cur_max = -1e15;
+		    bits = 0;
+		}
+
+		//compare with dp[i-1][j-1] in the bucket before s[i-1]
+		pre = q - p + (z + y) % p;
+		if(dp.trace[pre] & MODDP_REACHED){
+		    v1 = foldedStep(dp.min[pre], mt.sign[r*p+z], mt.A[r*p+z]);
+		    v2 = foldedStep(dp.max[pre], mt.sign[r*p+z], mt.A[r*p+z]);
+		    lt = v1 < v2;
+		    lo = lt ? v1 : v2;
+		    hi = lt ? v2 : v1;
+		    tmin = lo <= cur_min;
+		    tmax = hi >= cur_max;
+		    cur_min = tmin ? lo : cur_min;
+		    cur_max = tmax ? hi : cur_max;
+		    bits = MODDP_REACHED
+			| (tmax ? DPTRACE_MAXPRE | (lt ? DPTRACE_MAXMAX : 0)
+			   : DPTRACE_MAXMAX)
+			| (tmin ? DPTRACE_MINPRE | (lt ? 0 : DPTRACE_MINMAX) : 0);
+		}
+
+		dp.min[q+z] = cur_min;
+		dp.max[q+z] = cur_max;
+		dp.trace[q+z] = bits;
+	    }
+	}
+    }
 }
 
-unsigned int& Table::access(size_t i, size_t j){
-    return arr[((((n<<1)-i)*(i-1))>>1)+j-i-1];
+int getModDPBucket(const int n, const int k, const ModDPTable& dp,
+		   double* score){
+    size_t q = dpIndex(k, n, k) * dp.p;
+    for(int z=0; z<dp.p; ++z, ++q){
+	if(dp.trace[q] & MODDP_REACHED){
+	    *score = fabs(dp.min[q]);
+	    if(*score < dp.max[q]) *score = dp.max[q];
+	    return z;
+	}
+    }
+    return -1;
+}
+
+template<class T>
+bool backtrackModDPTable(const char* s, const int n, const int k,
+			 const ModRandTable& mt, const ModDPTable& dp,
+			 const int bucket, T* result){
+    *result = 0;
+    const int p = mt.p;
+    int i = 0, cur = n, z = bucket, c;
+    bool select, from_max;
+
+    size_t q = dpIndex(k, n, k);
+    uint8_t t = dp.trace[q*p+z];
+    if(dp.max[q*p+z] > fabs(dp.min[q*p+z])){
+	select = t & DPTRACE_MAXPRE;
+	from_max = t & DPTRACE_MAXMAX;
+    }else{
+	select = t & DPTRACE_MINPRE;
+	from_max = t & DPTRACE_MINMAX;
+    }
+
+    while(i < (k<<1)){
+	if(select){
+	    c = alphabetIndex(s[cur-1]);
+	    setKmerBase(*result, i, c);
+	    //the char is at row k-1-i/2
+	    z = (z + p - mt.shift[access2d(ALPHABETSIZE, k-1-(i>>1), c)]) % p;
+	    i += 2;
+	    q -= 1; //[i][j] to [i-1][j-1]
+	}else{
+	    q -= (k+1); //[i][j] to [i-1][j]
+	}
+	cur -= 1;
+
+	t = dp.trace[q*p+z];
+	if(from_max){
+	    select = t & DPTRACE_MAXPRE;
+	    from_max = t & DPTRACE_MAXMAX;
+	}else{
+	    select = t & DPTRACE_MINPRE;
+	    from_max = t & DPTRACE_MINMAX;
+	}
+    }
+
+    return (q == 0);
 }
 
-void Table::saveNoneZeroEntries(const char* filename, const char* mode/*="w"*/, const bool rev/*=false*/){
-    FILE* fout = fopen(filename, mode);
+template<class T>
+void getSubseqSeedsModThreshold(const std::string &read,
+				const int n, const int k,
+				const ModRandTable& mt,
+				const double threshold,
+				std::vector<SeedT<T> >& seeds_list){
+    if(read.length() < (size_t)n) return;
+
+    const char* s = read.c_str();
+    size_t len = read.length();
+    unsigned int i;
+    int z;
+    T seed;
+    double score;
+    ModDPTable dp(n+1, k, mt.p);
 
-    size_t i, j, k, size=(n*(n-1))>>1;
-    for(k=0, i=1, j=2; k<size; ++k){
-	if(arr[k] > 0){
-	    if(rev){
-		fprintf(fout, "%zu %zu %u\n", j, i, arr[k]);
-	    }else{
-		fprintf(fout, "%zu %zu %u\n", i, j, arr[k]);
+    for(i=0; i<len-n; i+=1){
+	fillModDPTable(s+i, n+1, k, mt, dp);
+
+	z = getModDPBucket(n, k, dp, &score);
+	if(score >= threshold){
+	    backtrackModDPTable(s+i, n, k, mt, dp, z, &seed);
+	    storeSeedWithPosInVector(seed, i, seeds_list);
+	}
+
+	//unlike getSubseqSeedsThreshold, a low score at [n+1][k] says
+	//nothing about window i+1, whose smallest bucket may be another
+	z = getModDPBucket(n+1, k, dp, &score);
+	if(!backtrackModDPTable(s+i, n+1, k, mt, dp, z, &seed)){
+	    ++i; //first char not used, seed of the next window
+	    if(score >= threshold){
+		storeSeedWithPosInVector(seed, i, seeds_list);
 	    }
 	}
-	j += 1;
-	if(j > n){
-	    i += 1;
-	    j = i + 1;
+    }
+
+    //last window, see getSubseqSeedsThreshold
+    if(i == len - n){
+	fillModDPTable(s+i, n, k, mt, dp);
+	z = getModDPBucket(n, k, dp, &score);
+	if(score >= threshold){
+	    backtrackModDPTable(s+i, n, k, mt, dp, z, &seed);
+	    storeSeedWithPosInVector(seed, i, seeds_list);
 	}
     }
-    
+}
+
+template<class T>
+void saveSubseqSeeds(const char* filename,
+		     const std::vector<SeedT<T> >& seeds_list){
+    FILE* fout = fopen(filename, "wb");
+    for(const SeedT<T>& s : seeds_list){
+	fwrite(&s, sizeof(s), 1, fout);
+    }
     fclose(fout);
 }
+
+//the k-mer types of the templates above
+#define INSTANTIATE(T) \
+    template T encode<T>(const char* s, const int k); \
+    template char* decode<T>(const T enc, const int k, char* str); \
+    template double getSeedScore<T>(const T seed, const int k, \
+				    const RandTableCell* tp); \
+    template double getSeedScore<T>(const T seed, const int k, \
+				    const FoldedRandTable& ft); \
+    template int64_t getSeedScore<T>(const T seed, const int k, \
+				     const IntRandTable& it); \
+    template bool backtrackDPTable<T>(const char* s, const int n, \
+				      const int k, const DPTable& dp, \
+				      T* result); \
+    template bool backtrackDPTable<T>(const PackedSeq& s, const int n, \
+				      const int k, const DPTable& dp, \
+				      T* result); \
+    template bool backtrackDPTableWithPos<T>(const char* s, const int n, \
+					     const int k, const DPTable& dp, \
+					     T* result, const int st, \
+					     int* pos); \
+    template void getSubseqSeedsThreshold<T>( \
+	const std::string &read, const int n, const int k, \
+	const RandTableCell* tp, const double threshold, \
+	std::vector<SeedT<T> >& seeds_list); \
+    template void getSubseqSeedsThresholdTwoTier<T>( \
+	const std::string &read, const int n, const int k, \
+	const RandTableCell* tp, const double threshold, \
+	std::vector<SeedT<T> >& seeds_list, const double* bound, \
+	SeedingStats* stats); \
+    template void getSubseqSeedsThresholdTwoTier<T>( \
+	const PackedSeq& s, const size_t len, const int n, const int k, \
+	const RandTableCell* tp, const double threshold, \
+	std::vector<SeedT<T> >& seeds_list, const double* bound, \
+	SeedingStats* stats); \
+    template bool backtrackModDPTable<T>( \
+	const char* s, const int n, const int k, const ModRandTable& mt, \
+	const ModDPTable& dp, const int bucket, T* result); \
+    template void getSubseqSeedsModThreshold<T>( \
+	const std::string &read, const int n, const int k, \
+	const ModRandTable& mt, const double threshold, \
+	std::vector<SeedT<T> >& seeds_list); \
+    template void saveSubseqSeeds<T>( \
+	const char* filename, const std::vector<SeedT<T> >& seeds_list);
+
+INSTANTIATE(kmer)
+INSTANTIATE(longkmer)
+#undef INSTANTIATE
@@ -10,12 +10,16 @@
 
 #include <cstdio>
 #include <cstring>
+#include <cstdint>
+#include <string>
+#include <utility>
 #include <map>
 #include <vector>
 #include <random>
 #include <chrono>
 #include <algorithm>
 //#include <queue>
+#include "LongKmer.hpp"
 
 
 /*
@@ -24,15 +28,36 @@
 */
 typedef __uint128_t kmer;
 
-struct Seed{
-    kmer v;
+static inline void setKmerBase(kmer& x, const int b, const int c){
+    x |= (kmer)c << b;
+}
+
+static inline int getKmerBase(const kmer x, const int b){
+    return (x >> b) & 3;
+}
+
+/*
+  The functions producing or consuming seeds are templates on the k-mer
+  type T, which is either kmer (k <= 64) or longkmer (k <= LONGKMERMAXK,
+  see LongKmer.hpp); they are instantiated for both.
+*/
+template<class T>
+struct SeedT{
+    T v;
     unsigned int pos;
     //number of consecutive windows that all produce this seed
-    unsigned int span;
-    Seed(const kmer v, const unsigned int pos): v(v), pos(pos), span(1) {};
-    Seed() {};
+    unsigned int span : 31;
+    //1 if v is the seed of the reverse complement of the window,
+    //always 0 unless the seeds are canonical (see simdDP.h)
+    unsigned int strand : 1;
+    SeedT(const T v, const unsigned int pos, const bool strand=false):
+	v(v), pos(pos), span(1), strand(strand) {};
+    SeedT() {};
 };
 
+typedef SeedT<kmer> Seed;
+typedef SeedT<longkmer> LongSeed;
+
 
 #define ALPHABETSIZE 4
 const char ALPHABET[ALPHABETSIZE] = {'A', 'C', 'G', 'T'};
@@ -41,17 +66,92 @@ static inline int alphabetIndex(char c){
     return 3 & ((c>>2) ^ (c>>1));
 }
 
+/*
+  Whether c is one of ACGT, lowercase (soft-masked) bases are also valid.
+  alphabetIndex maps every other char (e.g., N) to some base as well.
+*/
+static inline bool isValidBase(const char c){
+    switch(c | 0x20){
+    case 'a': case 'c': case 'g': case 't':
+	return true;
+    default:
+	return false;
+    }
+}
+
+/*
+  A read packed at 2 bits per base, base i is alphabetIndex(s[i]) at bits
+  2(i%32) and 2(i%32)+1 of words[i/32]. The runs [st, ed) of invalid bases
+  (see isValidBase) are kept separately, so a read takes about a quarter
+  of the memory of a std::string.
+*/
+struct PackedRead{
+    size_t len;
+    std::vector<uint64_t> words;
+    std::vector<std::pair<uint32_t, uint32_t> > invalid;
+
+    PackedRead(): len(0) {};
+    PackedRead(const char* s, const size_t len);
+    explicit PackedRead(const std::string& s):
+	PackedRead(s.c_str(), s.length()) {};
+
+    int base(const size_t i) const{
+	return (words[i>>5] >> ((i&31)<<1)) & 3;
+    }
+
+    /*
+      The chars of [st, st+l) as a string. Valid bases are given in
+      uppercase, invalid ones as one of NRYK, the invalid char with the
+      same alphabetIndex, so that the seeds are the same as with the
+      original read.
+    */
+    std::string unpack(const size_t st, const size_t l) const;
+    std::string unpack() const { return unpack(0, len); };
+};
+
+/*
+  Position st of a PackedRead, the counterpart of a char pointer into a
+  read for the dp functions below, e.g., s+i is position st+i. The bases
+  are read from the packed words, i.e., a window is neither unpacked nor
+  copied.
+*/
+struct PackedSeq{
+    const uint64_t* words;
+    size_t st;
+
+    explicit PackedSeq(const PackedRead& r, const size_t st=0):
+	words(r.words.data()), st(st) {};
+    PackedSeq(const uint64_t* w, const size_t st): words(w), st(st) {};
+    PackedSeq operator + (const size_t i) const{
+	return PackedSeq(words, st+i);
+    }
+};
+
+/*
+  alphabetIndex of the i-th char of a window.
+*/
+static inline int baseAt(const char* s, const size_t i){
+    return alphabetIndex(s[i]);
+}
+
+static inline int baseAt(const PackedSeq& s, const size_t i){
+    size_t p = s.st + i;
+    return (s.words[p>>5] >> ((p&31)<<1)) & 3;
+}
+
 /*
   Encode the string representation of a k-mer.
 */
-kmer encode(const char* s, const int k);
+template<class T=kmer>
+T encode(const char* s, const int k);
 
 /*
   Decode an k-mer into its string representation.
   If str is not null, it is used to store the resulting string; 
   otherwise a new char array is allocated.
 */
-char* decode(const kmer enc, const int k, char* str);
+template<class T>
+char* decode(const T enc, const int k, char* str);
 
 
 /*
@@ -62,14 +162,31 @@ char* decode(const kmer enc, const int k, char* str);
 
 
 /*
-  A cell in the DP table
+  The traceback bits of a cell [i][j] in the DP table.
 */
-typedef struct{
-    double max, min;
-    bool max_choose_pre, min_choose_pre; //for backtracking, cur at [i][j], true: [i-1][j-1], false: [i-1][j]
-    bool max_from_max, min_from_max; //for backtracking, true if the value is obtained from max of the prev cell (determined by above two bools)
-} DPCell;
-//extern DPCell dp[n][k];
+#define DPTRACE_MAXPRE 1 //max_choose_pre, true: [i-1][j-1], false: [i-1][j]
+#define DPTRACE_MINPRE 2 //min_choose_pre
+#define DPTRACE_MAXMAX 4 //max_from_max, true if the value is obtained from max of the prev cell (determined by above two bits)
+#define DPTRACE_MINMAX 8 //min_from_max
+
+/*
+  The DP table of an n-mer. Only the band of meaningful cells [i][j] with
+  0 <= i-j <= n-k is stored, diagonal by diagonal (see dpIndex), as
+  separate arrays of min and max values and 4 traceback bits per cell
+  packed two cells per byte (the even cell in the lower half).
+  Since the index of a cell does not depend on n, a table of n chars also
+  holds the tables of its prefixes of at least k chars.
+  Column 0 (nothing selected yet) is all zeros.
+*/
+struct DPTable{
+    int n, k;
+    std::vector<double> min, max;
+    std::vector<uint8_t> trace;
+
+    DPTable(const int n, const int k):
+	n(n), k(k), min((n-k+1)*(k+1)), max((n-k+1)*(k+1)),
+	trace(((n-k+1)*(k+1)+1)>>1) {};
+};
 
 /*
   The set of random tables determining a total order on all bmers.
@@ -85,6 +202,77 @@ static inline size_t access2d(const size_t row_len,
     return row_len * i + j;
 }
 
+/*
+  The random tables folded for a branch-free dp: choosing the char c at
+  row j turns the value x of the previous cell into 
+  foldedStep(x, sign[j][c], A[j][c]), which is exactly
+  (B1 ? x : -x) + (B2 ? A : -A) of the original table.
+  --A[j][c] is A if B2 else -A;
+  --sign[j][c] is 0 if B1 else the sign bit of a double.
+*/
+struct FoldedRandTable{
+    int k;
+    std::vector<double> A;
+    std::vector<uint64_t> sign;
+
+    FoldedRandTable(const int k):
+	k(k), A(k*ALPHABETSIZE), sign(k*ALPHABETSIZE) {};
+    FoldedRandTable(const int k, const RandTableCell* tp);
+};
+
+#define DOUBLESIGNBIT ((uint64_t)1 << 63)
+
+static inline double foldedStep(const double x, const uint64_t sign,
+				const double a){
+    uint64_t bits;
+    double y;
+    memcpy(&bits, &x, sizeof bits);
+    bits ^= sign;
+    memcpy(&y, &bits, sizeof y);
+    return y + a;
+}
+
+/*
+  Fixed-point version of the random tables for the integer scoring mode.
+  A is divided by 2^shift and truncated to an int32, shift is the
+  smallest such that k * 2^{31-shift} <= 2^31, hence every omega (and
+  every dp value) fits in an int32 and the results do not depend on the
+  floating point behavior of the machine. Omega is still accumulated in
+  int64 outside of the simd kernels.
+  --A[j][c] is the truncated A if B2 else its negation;
+  --neg[j][c] is 0 if B1 else -1, x is negated as (x ^ neg) - neg.
+*/
+struct IntRandTable{
+    int k, shift;
+    std::vector<int32_t> A, neg;
+
+    IntRandTable(const int k):
+	k(k), shift(0), A(k*ALPHABETSIZE), neg(k*ALPHABETSIZE) {};
+};
+
+/*
+  File format written by saveIntRandTable: the 4 chars INTRANDTABLEMAGIC,
+  then uint32 version, int32 k, int32 shift, followed by k*ALPHABETSIZE
+  records of {int32 |A|, uint8 B1, uint8 B2} in the order of
+  RandTableCell[k][ALPHABETSIZE], all in the native byte order (as
+  saveRandTable), i.e., not portable across endianness.
+*/
+#define INTRANDTABLEMAGIC "SSIT"
+#define INTRANDTABLEVERSION 1
+
+static inline int64_t intFoldedStep(const int64_t x, const int32_t neg,
+				    const int32_t a){
+    return (x ^ neg) - neg + a;
+}
+
+/*
+  Index of the cell [i][j] in a DPTable, [i][j-1] and [i][j] of a
+  diagonal i-j are consecutive.
+*/
+static inline size_t dpIndex(const int k, const int i, const int j){
+    return access2d(k+1, i-j, j);
+}
+
 /*
   Initialize the random tables:
   --tp is RandTableCell[k][ALPHABETSIZE] flattened;
@@ -103,20 +291,65 @@ void saveRandTable(const char* filename, const int k, const RandTableCell* tp);
 void loadRandTable(const char* filename, const int k, RandTableCell* tp);
 void printRandTable(const int k, const RandTableCell* tp);
 
+/*
+  Quantize a set of random tables for the integer scoring mode.
+*/
+void quantizeRandTable(const int k, const RandTableCell* tp,
+		       IntRandTable& it);
+
+/*
+  Save/load a set of integer random tables in the versioned format above.
+  The loader returns false (with a message on stderr) if the file is not
+  such a table, has a different version or k, or its values may overflow.
+*/
+void saveIntRandTable(const char* filename, const IntRandTable& it);
+bool loadIntRandTable(const char* filename, const int k, IntRandTable& it);
+
 /*
   Given a k-mer seed, calculate its score according to the random tables tp.
   --tp is RandTableCell[k][ALPHABETSIZE] flattened;
 */
-double getSeedScore(const kmer seed, const int k, const RandTableCell* tp);
+template<class T>
+double getSeedScore(const T seed, const int k, const RandTableCell* tp);
+template<class T>
+double getSeedScore(const T seed, const int k, const FoldedRandTable& ft);
+template<class T>
+int64_t getSeedScore(const T seed, const int k, const IntRandTable& it);
 
 /*
   Given a char-representation of an n-mer s and a set of random tables,
   fill the dp table according to the total order defined by the random tables.
-  --tp is RandTableCell[k][ALPHABETSIZE] flattened;
-  --dpp is DPCell[n+1][k+1] flattened.
+  --ft is the folded RandTableCell[k][ALPHABETSIZE];
+  --dp is constructed with at least n and the same k.
 */
 void fillDPTable(const char* s, const int n, const int k,
-		 const RandTableCell* tp, DPCell* dpp);
+		 const FoldedRandTable& ft, DPTable& dp);
+
+/*
+  Upper bounds for branch-and-bound pruning of the dp: since |omega| grows
+  by at most A per selected char, bound[j] is the sum over rows j..k-1 of
+  the largest A in each row, bound[k] = 0.
+  --tp is RandTableCell[k][ALPHABETSIZE] flattened;
+  --bound is double[k+1].
+*/
+void initSuffixBounds(const int k, const RandTableCell* tp, double* bound);
+
+/*
+  Score-only version of fillDPTable used to filter windows before the
+  traceback is needed. Only one row of min and one row of max values are
+  kept (updated in place) and no traceback info is recorded. The values
+  are identical to those computed by fillDPTable.
+  Return the score (max absolute value) at [n][k]; if prev_score is not
+  null, the score at [n-1][k] is stored there (n-1 must be at least k).
+  If bound (from initSuffixBounds) is given, the window is abandoned as
+  soon as no cell of the current row can reach threshold at [n][k], in
+  which case -1 is returned (and stored in prev_score).
+  --ft is the folded RandTableCell[k][ALPHABETSIZE];
+  --rows is double[2][k+1] flattened, min followed by max.
+*/
+double scoreDPTable(const char* s, const int n, const int k,
+		    const FoldedRandTable& ft, double* rows, double* prev_score,
+		    const double* bound=NULL, const double threshold=0);
 
 /*
   After filling the dp table by fillDPTable, backtrack from the given
@@ -124,10 +357,11 @@ void fillDPTable(const char* s, const int n, const int k,
   Return true if the first char of the n-mer s is selected, false otherwise. 
   This is used for the heuristic speedup of calculating one additional
   column of the dp table.
-  --dpp is at least DPCell[n+1][k+1] (maybe DPCell[n+2][k+1]) flattened.
+  --dp may be filled with more than n chars (e.g., n+1).
 */
+template<class T>
 bool backtrackDPTable(const char* s, const int n, const int k,
-		      const DPCell* dpp, kmer* result);
+		      const DPTable& dp, T* result);
 
 /*
   Same as above but also record position info for each char of the 
@@ -135,10 +369,24 @@ bool backtrackDPTable(const char* s, const int n, const int k,
   first char of s.
   --pos is assumed to have length at least k
 */
+template<class T>
 bool backtrackDPTableWithPos(const char* s, const int n, const int k,
-			     const DPCell* dpp, kmer* result,
+			     const DPTable& dp, T* result,
 			     const int st, int* pos);
 
+/*
+  fillDPTable, scoreDPTable and backtrackDPTable on a window of a packed
+  read (see PackedSeq).
+*/
+void fillDPTable(const PackedSeq& s, const int n, const int k,
+		 const FoldedRandTable& ft, DPTable& dp);
+double scoreDPTable(const PackedSeq& s, const int n, const int k,
+		    const FoldedRandTable& ft, double* rows, double* prev_score,
+		    const double* bound=NULL, const double threshold=0);
+template<class T>
+bool backtrackDPTable(const PackedSeq& s, const int n, const int k,
+		      const DPTable& dp, T* result);
+
 
 /*
   Given a char-representation of a read and a set of random tables, 
@@ -151,47 +399,227 @@ bool backtrackDPTableWithPos(const char* s, const int n, const int k,
     it will also be stored multiple times in the vector. 
   Only seeds whose scores are at least the given threshold are generated/stored.
 */
+template<class T>
 void getSubseqSeedsThreshold(const std::string &read,
 			     const int n, const int k,
 			     const RandTableCell* tp, const double threshold,
-			     std::vector<Seed>& seeds_list);
+			     std::vector<SeedT<T> >& seeds_list);
 
 /*
-  Save seeds of a read to file.
-  The seeds are saved in ascending order with respect to their starting
-  positions in the read. A seed can appear multiple times if it is selected
-  from different (non-consecutive) positions in the read.
-  Each seed is stored in binary format by fwrite, and can be read by fread.
+  Counters of seeding runs, accumulated by the seeding functions that
+  take a pointer to it.
 */
-void saveSubseqSeeds(const char* filename,
-		     const std::vector<Seed>& seeds_list);
+struct SeedingStats{
+    size_t windows; //number of windows processed
+    size_t pruned; //windows rejected by branch-and-bound (scoreDPTable)
+    size_t skipped; //windows with an invalid base (getValidSegments)
+
+    SeedingStats(): windows(0), pruned(0), skipped(0) {};
+    SeedingStats& operator += (const SeedingStats& o){
+	windows += o.windows;
+	pruned += o.pruned;
+	skipped += o.skipped;
+	return *this;
+    }
+};
+
+/*
+  The maximal substrings of the len chars of a packed read from st
+  without invalid bases (see isValidBase) that have at least one window,
+  as [a, b) relative to st with b-a >= n. They are found from the runs of
+  invalid bases kept by the read, so no char is scanned. The number of
+  windows that are not in any segment is added to stats->skipped if
+  stats is not null.
+*/
+void getValidSegments(const PackedRead& read, const size_t st,
+		      const size_t len, const int n,
+		      std::vector<std::pair<size_t, size_t> >& segments,
+		      SeedingStats* stats=NULL);
+
+/*
+  Append a seed of the window starting at pos to the seeds of a read,
+  only the span of the last seed is incremented if they are the same
+  (on the same strand).
+*/
+template<class T>
+static inline void storeSeedWithPosInVector(const T seed,
+					    const unsigned int pos,
+					    std::vector<SeedT<T> >& seeds_list,
+					    const bool strand=false){
+    //skip the same seed from consecutive positions
+    if(seeds_list.size() > 0){
+	SeedT<T>& s = seeds_list.back();
+	if(s.v == seed && s.strand == strand){
+	    ++ s.span;
+	    return;
+	}
+    }
+    seeds_list.emplace_back(seed, pos, strand);
+}
+
+/*
+  Append the seeds of a chunk of a read (whose first window is at offset)
+  to the seeds of the preceding windows. The first seed of the chunk is
+  merged into the last one as storeSeedWithPosInVector does, so that
+  chunks seeded separately give the same seeds as the whole read.
+*/
+template<class T>
+static inline void appendSeedsInVector(const std::vector<SeedT<T> >& chunk,
+				       const unsigned int offset,
+				       std::vector<SeedT<T> >& seeds_list){
+    size_t i = 0;
+    if(chunk.size() > 0 && seeds_list.size() > 0){
+	SeedT<T>& s = seeds_list.back();
+	if(s.v == chunk[0].v && s.strand == chunk[0].strand){
+	    s.span += chunk[0].span;
+	    i = 1;
+	}
+    }
+    for(; i<chunk.size(); ++i){
+	seeds_list.push_back(chunk[i]);
+	seeds_list.back().pos += offset;
+    }
+}
+
+/*
+  Same as getSubseqSeedsThreshold (identical seeds and positions), but
+  each window is first scored by scoreDPTable, fillDPTable is only called
+  on windows that pass the threshold (with the extra column).
+  If bound is given (see initSuffixBounds), hopeless windows are pruned
+  during the score-only pass. Counters are added to stats if not null.
+*/
+template<class T>
+void getSubseqSeedsThresholdTwoTier(const std::string &read,
+				    const int n, const int k,
+				    const RandTableCell* tp,
+				    const double threshold,
+				    std::vector<SeedT<T> >& seeds_list,
+				    const double* bound=NULL,
+				    SeedingStats* stats=NULL);
+
+/*
+  Same as above on the len chars of a packed read from s (e.g., a chunk
+  of it), the positions of the seeds are relative to s.
+*/
+template<class T>
+void getSubseqSeedsThresholdTwoTier(const PackedSeq& s, const size_t len,
+				    const int n, const int k,
+				    const RandTableCell* tp,
+				    const double threshold,
+				    std::vector<SeedT<T> >& seeds_list,
+				    const double* bound=NULL,
+				    SeedingStats* stats=NULL);
+
+/*
+  The modular ("p-bucket") variant of the subsequence hash: a k-mer also
+  falls into one of p buckets, the sum mod p of shift[j][c] over its
+  chars c at rows j, and the random tables are drawn per bucket.
+  Choosing the char c at row j into bucket z turns the value x of the
+  previous cell into foldedStep(x, sign[j][c][z], A[j][c][z]) (see
+  FoldedRandTable). The seed of a window is its best k-mer in the
+  smallest bucket reachable at [n][k].
+  --shift[j][] are ALPHABETSIZE distinct values, hence p >= ALPHABETSIZE;
+  --shift is int[k][ALPHABETSIZE], A and sign are [k][ALPHABETSIZE][p],
+    all flattened.
+*/
+struct ModRandTable{
+    int k, p;
+    std::vector<int> shift;
+    std::vector<double> A;
+    std::vector<uint64_t> sign;
+
+    ModRandTable(const int k=0, const int p=0):
+	k(k), p(p), shift(k*ALPHABETSIZE), A(k*ALPHABETSIZE*p),
+	sign(k*ALPHABETSIZE*p) {};
+};
+
+/*
+  Initialize the tables as initRandTable does for each bucket: A takes
+  values between 2^{30} and 2^{31} and the (B1, B2) of the chars of
+  [j][][z] are a permutation; shift[j][] are drawn from a random
+  permutation of [0, p).
+*/
+void initModRandTable(const int k, const int p, ModRandTable& mt);
 
 /*
-  Read seeds of a read from file, merge them into a map where the seed
-  is key and value is a vector of read ids.
-  The seed location info is currently unused.
-  ********
-  This method is assumed to be called in ascending order of read_id so
-  that each vector (associated to a seed) is in sorted order.
+  File format written by saveModRandTable: the 4 chars MODRANDTABLEMAGIC,
+  then uint32 version, int32 k, int32 p, k*ALPHABETSIZE int32 shifts,
+  followed by k*ALPHABETSIZE*p records of {double A, uint8 B1, uint8 B2}
+  in the order of [k][ALPHABETSIZE][p], all in the native byte order
+  (not portable across endianness). The loader returns false (with a
+  message on stderr) if the file is not such a table or has a different
+  version, k or p.
 */
-void loadSubseqSeeds(const char* filename, const int read_id,
-		     std::map<kmer, std::vector<int> > &all_seeds);
+#define MODRANDTABLEMAGIC "SSMT"
+#define MODRANDTABLEVERSION 1
 
+void saveModRandTable(const char* filename, const ModRandTable& mt);
+bool loadModRandTable(const char* filename, const int k, const int p,
+		      ModRandTable& mt);
 
 /*
-  An upper diagonal matrix without the main diagonal,
-  valid indices for Table::access(i, j) are 1<=i<j<=n
+  The dp table of the modular variant, banded as DPTable with the p
+  buckets of a cell consecutive, i.e., bucket z of [i][j] is at
+  dpIndex(k, i, j)*p + z, and one byte of traceback bits per bucket.
+  A fill overwrites every cell of its band, so the table is reused by
+  consecutive windows without being cleared. All the state of the
+  functions below is in the tables passed to them, so they can run
+  concurrently with a ModDPTable per thread.
 */
-class Table{
-    size_t n;
-    unsigned int* arr;
+#define MODDP_REACHED 16 //some k-mer (or j-mer) falls into this bucket
 
-public:
-    Table(size_t n);
-    ~Table();
-    unsigned int& access(size_t i, size_t j);
-    //for cell[i][j], output i j, if rev, output j i
-    void saveNoneZeroEntries(const char* filename, const char* mode="w", const bool rev=false);
+struct ModDPTable{
+    int n, k, p;
+    std::vector<double> min, max;
+    std::vector<uint8_t> trace;
+
+    ModDPTable(const int n, const int k, const int p);
 };
 
+/*
+  Same as fillDPTable with the modular tables.
+  --dp is constructed with at least n and the same k and p.
+*/
+void fillModDPTable(const char* s, const int n, const int k,
+		    const ModRandTable& mt, ModDPTable& dp);
+
+/*
+  The smallest bucket reachable at [n][k], its score (max absolute
+  value) is stored in score.
+*/
+int getModDPBucket(const int n, const int k, const ModDPTable& dp,
+		   double* score);
+
+/*
+  Same as backtrackDPTable from the given bucket of [n][k].
+*/
+template<class T>
+bool backtrackModDPTable(const char* s, const int n, const int k,
+			 const ModRandTable& mt, const ModDPTable& dp,
+			 const int bucket, T* result);
+
+/*
+  Same as getSubseqSeedsThreshold with the modular variant. The extra
+  column is used as well: the buckets of window i+1 are a subset of
+  those of s[i..i+n], so a seed of the latter that does not use s[i] is
+  also the seed of window i+1.
+*/
+template<class T>
+void getSubseqSeedsModThreshold(const std::string &read,
+				const int n, const int k,
+				const ModRandTable& mt,
+				const double threshold,
+				std::vector<SeedT<T> >& seeds_list);
+
+/*
+  Save seeds of a read to file.
+  The seeds are saved in ascending order with respect to their starting
+  positions in the read. A seed can appear multiple times if it is selected
+  from different (non-consecutive) positions in the read.
+  Each seed is stored in binary format by fwrite, and can be read by fread.
+*/
+template<class T>
+void saveSubseqSeeds(const char* filename,
+		     const std::vector<SeedT<T> >& seeds_list);
+
 #endif // util.h